@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cmath>
+
+#include "audio.h"
+
+#define audio_volume 0.2f
+
+size_t beeper::queued() const
+{
+    return head.load(std::memory_order_acquire) -
+           tail.load(std::memory_order_acquire);
+}
+
+void beeper::push(float sample)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+
+    // a full ring means nobody is listening fast enough, drop the sample
+    if (h - tail.load(std::memory_order_acquire) == audio_ring)
+        return;
+
+    ring[h & (audio_ring - 1)] = sample;
+    head.store(h + 1, std::memory_order_release);
+}
+
+void beeper::frame(const chip8 &c)
+{
+    size_t fill = queued();
+
+    // after a stall, e.g. the window being dragged, refill with silence
+    // instead of crawling back at the drift rate
+    for (; fill < audio_target / 2; fill++)
+        push(0.0f);
+
+    // run slightly fast or slow to hold the fill level, this absorbs the
+    // 60 Hz frame clock drifting against the device clock, trim settles on
+    // the steady difference over about ten seconds
+    double error = std::clamp(((double)audio_target - fill) / audio_target,
+                              -1.0, 1.0);
+    trim = std::clamp(trim + audio_drift * error / 600.0, -audio_drift,
+                      audio_drift);
+    carry += audio_rate / 60.0 *
+             (1.0 + std::clamp(audio_drift * error + trim, -audio_drift,
+                               audio_drift));
+
+    size_t n = (size_t)carry;
+    carry -= n;
+
+    // XO-CHIP pitch 64 is 4000 bits per second, 48 steps an octave, the
+    // default pattern is then a 500 Hz square wave
+    double step = 4000.0 * std::exp2((c.pitch - 64) / 48.0) / audio_rate;
+
+    for (size_t j = 0; j < n; j++) {
+        size_t bit = (size_t)phase;
+        bool high = c.pattern[bit >> 3] & (0x80 >> (bit & 0x7));
+
+        float target = c.sound ? (high ? audio_volume : -audio_volume) : 0.0f;
+
+        // a touch of smoothing so edges and key clicks do not pop
+        level += (target - level) * 0.25f;
+        push(level);
+
+        phase += step;
+        if (phase >= 128.0)
+            phase -= 128.0;
+    }
+}
+
+void beeper::read(float *out, size_t n)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    size_t j = 0;
+
+    for (; j < n && t != h; j++, t++)
+        out[j] = last = ring[t & (audio_ring - 1)];
+
+    tail.store(t, std::memory_order_release);
+
+    // ran dry, fade whatever was playing rather than cutting it off
+    for (; j < n; j++)
+        out[j] = last *= 0.95f;
+}
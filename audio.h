@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "chip8.h"
+
+// output sample rate, mono float samples
+#define audio_rate 48000
+// capacity of the ring between the emulation and the audio device
+#define audio_ring (1 << 13)
+// samples the producer tries to keep queued, about four frames
+#define audio_target 3200
+// largest speed-up or slow-down used to hold the fill level, 0.5 %
+#define audio_drift 0.005
+
+/**
+ * @brief beeper samples handed from the emulation to the audio device
+ * through a single producer single consumer ring, neither side blocks or
+ * allocates
+ */
+class beeper
+{
+public:
+    /**
+     * @brief queue one 60 Hz frame of samples, the machine's pattern sounds
+     * while its sound timer is running, call once per frame before
+     * chip8::tick()
+     */
+    void frame(const chip8 &c);
+
+    /**
+     * @brief fill out with n samples, pads with silence on an underrun,
+     * safe to call from the audio callback
+     */
+    void read(float *out, size_t n);
+
+    /**
+     * @brief samples queued right now
+     */
+    size_t queued() const;
+
+private:
+    void push(float sample);
+
+    float ring[audio_ring];
+
+    // producer side
+    double phase = 0.0;
+    double carry = 0.0;
+    double trim = 0.0;
+    float level = 0.0f;
+
+    // consumer side
+    float last = 0.0f;
+
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
@@ -0,0 +1,293 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+#include "lockstep.h"
+#include "rom.h"
+
+/**
+ * @brief a rom to time, either built in or loaded from a path
+ */
+struct workload {
+    std::string name;
+    std::vector<uint8_t> rom;
+    const char *path;
+    const uint8_t *image = nullptr; // inside a mapped library
+    size_t size = 0;
+};
+
+struct result {
+    uint64_t cycles;
+    double mean_ns;     // per instruction
+    double variance_ns; // across repetitions
+    double min_ns;
+    double max_ns;
+};
+
+static std::vector<uint8_t> assemble(std::initializer_list<uint16_t> ops);
+static bool measure(const workload &w, bool jit, uint64_t cycles,
+                    size_t reps, result &r);
+static bool measure_lanes(const workload &w, size_t lanes, uint64_t cycles,
+                          size_t reps, result &r);
+static void summarize(const std::vector<double> &samples, result &r);
+
+int main(int argc, char *argv[])
+{
+    uint64_t cycles = 20000000;
+    size_t reps = 5;
+    bool interp = true;
+    bool jit = true;
+    size_t lanes = 0;
+    std::vector<workload> workloads;
+    rom_library library;
+
+    // 8XY* arithmetic and logic only, closed by a jump
+    workloads.push_back(
+        {"alu",
+         assemble({0x6001, 0x6102, 0x6203, 0x8014, 0x8125, 0x8236, 0x8017,
+                   0x812E, 0x8201, 0x8312, 0x8423, 0x8504, 0x8010, 0x7001,
+                   0x1206}),
+         nullptr});
+
+    // font sprites drawn back to back with wrapping coordinates
+    workloads.push_back({"sprites",
+                         assemble({0x6000, 0x6100, 0x6200, 0xF229, 0xD01F,
+                                   0x7005, 0x7103, 0x7201, 0x1206}),
+                         nullptr});
+
+    // four nested calls and returns per iteration
+    workloads.push_back(
+        {"calls",
+         assemble({0x2204, 0x1200, 0x2208, 0x00EE, 0x220C, 0x00EE, 0x2210,
+                   0x00EE, 0x7001, 0x00EE}),
+         nullptr});
+
+    // register dumps and loads through I
+    workloads.push_back(
+        {"memory",
+         assemble({0xA300, 0xF755, 0xF765, 0x7001, 0xFF55, 0xFF65, 0x1202}),
+         nullptr});
+
+    for (int arg = 1; arg < argc; arg++) {
+        std::string opt = argv[arg];
+        if (opt == "--cycles" && arg + 1 < argc)
+            cycles = std::stoull(argv[++arg]);
+        else if (opt == "--reps" && arg + 1 < argc)
+            reps = std::stoul(argv[++arg]);
+        else if (opt == "--interp")
+            jit = false;
+        else if (opt == "--jit")
+            interp = false;
+        else if (opt == "--lanes" && arg + 1 < argc)
+            lanes = std::stoul(argv[++arg]);
+        else if (opt == "--library" && arg + 1 < argc) {
+            if (!library.open(argv[++arg])) {
+                std::cerr << "Error: invalid library" << std::endl;
+                return 1;
+            }
+
+            for (size_t n = 0; n < library.count(); n++) {
+                const library_entry &e = library.entry(n);
+                workloads.push_back({std::string(library.name(e)),
+                                     {},
+                                     nullptr,
+                                     library.rom(e),
+                                     e.size});
+            }
+        }
+        else if (opt.starts_with("--")) {
+            std::cerr << "Usage: [--cycles <n>] [--reps <n>] "
+                         "[--interp | --jit] [--lanes <n>] "
+                         "[--library <path>] [rom...]"
+                      << std::endl;
+            return 1;
+        } else {
+            std::string name = opt.substr(opt.find_last_of('/') + 1);
+            workloads.push_back({name, {}, argv[arg]});
+        }
+    }
+
+    if (lanes > max_lanes) {
+        std::cerr << "Error: at most " << max_lanes << " lanes" << std::endl;
+        return 1;
+    }
+
+    if (reps == 0 || cycles == 0) {
+        std::cerr << "Error: cycles and reps must be at least 1" << std::endl;
+        return 1;
+    }
+
+    std::cout << "{\n  \"cycles\": " << cycles << ",\n  \"reps\": " << reps
+              << ",\n  \"results\": [";
+
+    bool first = true;
+    const char *backends[] = {"interp", "jit", "lanes"};
+
+    for (const workload &w : workloads) {
+        for (int backend = 0; backend < 3; backend++) {
+            if ((backend == 0 && !interp) || (backend == 1 && !jit) ||
+                (backend == 2 && !lanes))
+                continue;
+
+            result r;
+            bool ok = backend == 2
+                          ? measure_lanes(w, lanes, cycles, reps, r)
+                          : measure(w, backend == 1, cycles, reps, r);
+            if (!ok) {
+                std::cerr << "Error: cannot run " << w.name << std::endl;
+                return 1;
+            }
+
+            std::cout << (first ? "\n" : ",\n")
+                      << std::format(
+                             "    {{\"name\": \"{}\", \"backend\": \"{}\", "
+                             "\"cycles\": {}, \"mips\": {:.2f}, "
+                             "\"ns_per_instr\": {:.3f}, "
+                             "\"variance_ns\": {:.6f}, \"min_ns\": {:.3f}, "
+                             "\"max_ns\": {:.3f}}}",
+                             w.name, backends[backend],
+                             r.cycles, 1e3 / r.mean_ns, r.mean_ns,
+                             r.variance_ns, r.min_ns, r.max_ns);
+            first = false;
+        }
+    }
+
+    std::cout << "\n  ]\n}" << std::endl;
+
+    return 0;
+}
+
+std::vector<uint8_t> assemble(std::initializer_list<uint16_t> ops)
+{
+    std::vector<uint8_t> rom;
+
+    for (uint16_t op : ops) {
+        rom.push_back(op >> 8);
+        rom.push_back(op & 0xFF);
+    }
+
+    return rom;
+}
+
+bool measure(const workload &w, bool jit, uint64_t cycles, size_t reps,
+             result &r)
+{
+    std::vector<double> samples;
+
+    for (size_t rep = 0; rep < reps; rep++) {
+        chip8 machine;
+
+        bool loaded = w.path    ? machine.load(w.path)
+                      : w.image ? machine.load(w.image, w.size)
+                                : machine.load(w.rom.data(), w.rom.size());
+        if (!loaded)
+            return false;
+
+        machine.seed(rep);
+
+        // the jit falls back to the interpreter where unsupported
+        machine.use_jit(jit);
+
+        auto start = std::chrono::steady_clock::now();
+
+        // tick the timers every 10000 instructions so roms waiting on the
+        // delay timer keep moving
+        while (machine.cycles < cycles && !machine.halted()) {
+            uint64_t budget = std::min<uint64_t>(10000, cycles - machine.cycles);
+            machine.run(budget);
+            machine.tick();
+        }
+
+        std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        if (machine.cycles == 0)
+            return false;
+
+        r.cycles = machine.cycles;
+        samples.push_back(elapsed.count() / machine.cycles);
+    }
+
+    summarize(samples, r);
+
+    return true;
+}
+
+bool measure_lanes(const workload &w, size_t lanes, uint64_t cycles,
+                   size_t reps, result &r)
+{
+    std::vector<double> samples;
+    const uint8_t *rom = w.image ? w.image : w.rom.data();
+    size_t size = w.image ? w.size : w.rom.size();
+    mapped_file f;
+
+    if (w.path) {
+        if (!f.open(w.path))
+            return false;
+        rom = f.data();
+        size = f.size();
+    }
+
+    for (size_t rep = 0; rep < reps; rep++) {
+        lockstep machine(lanes);
+
+        if (!machine.load(rom, size))
+            return false;
+
+        for (size_t l = 0; l < lanes; l++)
+            machine.seed(l, rep * lanes + l);
+
+        auto start = std::chrono::steady_clock::now();
+
+        // cycles counts instructions across all lanes, lane 0 sets the pace
+        // since every lane runs the same budget
+        uint64_t per_lane = std::max<uint64_t>(cycles / lanes, 1);
+        while (machine.cycles[0] < per_lane && !machine.halted(0)) {
+            machine.run(std::min<uint64_t>(10000,
+                                           per_lane - machine.cycles[0]));
+            machine.tick();
+        }
+
+        std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        uint64_t done = 0;
+        for (size_t l = 0; l < lanes; l++)
+            done += machine.cycles[l];
+
+        if (done == 0)
+            return false;
+
+        r.cycles = done;
+        samples.push_back(elapsed.count() / done);
+    }
+
+    summarize(samples, r);
+
+    return true;
+}
+
+void summarize(const std::vector<double> &samples, result &r)
+{
+    double sum = 0.0;
+    r.min_ns = samples[0];
+    r.max_ns = samples[0];
+
+    for (double s : samples) {
+        sum += s;
+        r.min_ns = std::min(r.min_ns, s);
+        r.max_ns = std::max(r.max_ns, s);
+    }
+
+    r.mean_ns = sum / samples.size();
+    r.variance_ns = 0.0;
+
+    for (double s : samples)
+        r.variance_ns += (s - r.mean_ns) * (s - r.mean_ns);
+    r.variance_ns /= samples.size();
+}
@@ -0,0 +1,185 @@
+#include <cstring>
+#include <iostream>
+
+#include "capture.h"
+
+// y4m pictures are always the hires size
+#define picture_size (display_w * display_h)
+
+frame_capture::~frame_capture() { close(); }
+
+bool frame_capture::open(const char *path, capture_format format)
+{
+    this->format = format;
+
+    if (strcmp(path, "-") == 0)
+        out = &std::cout;
+    else {
+        file.open(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        out = &file;
+    }
+
+    if (format == capture_y4m)
+        *out << "YUV4MPEG2 W" << display_w << " H" << display_h
+             << " F60:1 Ip A1:1 C444\n";
+    else {
+        capture_header header = {capture_magic, capture_version, display_w,
+                                 display_h,     60,              display_planes};
+        out->write((const char *)&header, sizeof(header));
+    }
+
+    if (!out->good())
+        return false;
+
+    pool = new buffer[capture_pool];
+    picture.resize(3 * picture_size);
+    writer = std::thread(&frame_capture::drain, this);
+    return true;
+}
+
+void frame_capture::close()
+{
+    if (!writer.joinable())
+        return;
+
+    // the newest frame is done counting repeats
+    if (started)
+        head.store(head.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+
+    stop.store(true, std::memory_order_release);
+    signal.fetch_add(1, std::memory_order_release);
+    signal.notify_one();
+    writer.join();
+    out->flush();
+
+    if (file.is_open())
+        file.close();
+
+    delete[] pool;
+    pool = nullptr;
+}
+
+void frame_capture::frame(const chip8 &c)
+{
+    if (!pool)
+        return;
+
+    size_t h = head.load(std::memory_order_relaxed);
+    buffer &last = pool[h & (capture_pool - 1)];
+
+    if (started && last.hires == c.hires &&
+        memcmp(last.rows, c.framebuffer, sizeof(last.rows)) == 0) {
+        last.repeat++;
+        return;
+    }
+
+    // hand the previous frame to the writer and wait for a free buffer,
+    // only when the writer is a whole pool of changed frames behind
+    if (started) {
+        head.store(++h, std::memory_order_release);
+        signal.fetch_add(1, std::memory_order_release);
+        signal.notify_one();
+
+        while (h + 1 - tail_seen > capture_pool) {
+            tail_seen = tail.load(std::memory_order_acquire);
+            if (h + 1 - tail_seen > capture_pool)
+                std::this_thread::yield();
+        }
+    }
+
+    buffer &next = pool[h & (capture_pool - 1)];
+    memcpy(next.rows, c.framebuffer, sizeof(next.rows));
+    next.hires = c.hires;
+    next.repeat = 1;
+    started = true;
+}
+
+void frame_capture::drain()
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+
+    for (;;) {
+        // read the signal first, anything published after it wakes the
+        // wait below, and stop before head so frames published before it
+        // are still seen
+        uint32_t seen = signal.load(std::memory_order_acquire);
+        bool last = stop.load(std::memory_order_acquire);
+        size_t h = head.load(std::memory_order_acquire);
+
+        if (h == t) {
+            if (last)
+                return;
+            signal.wait(seen, std::memory_order_acquire);
+            continue;
+        }
+
+        for (; t != h; t++) {
+            write(pool[t & (capture_pool - 1)]);
+            tail.store(t + 1, std::memory_order_release);
+        }
+    }
+}
+
+/**
+ * @brief BT.601 studio swing Y, Cb and Cr of an RGBA4444 color
+ */
+static void to_yuv(uint16_t rgba, uint8_t yuv[3])
+{
+    int r = (rgba >> 12 & 0xF) * 0x11;
+    int g = (rgba >> 8 & 0xF) * 0x11;
+    int b = (rgba >> 4 & 0xF) * 0x11;
+
+    yuv[0] = 16 + (66 * r + 129 * g + 25 * b + 128) / 256;
+    yuv[1] = 128 + (-38 * r - 74 * g + 112 * b + 128) / 256;
+    yuv[2] = 128 + (112 * r - 94 * g - 18 * b + 128) / 256;
+}
+
+void frame_capture::write(const buffer &b)
+{
+    if (format == capture_raw) {
+        capture_record r = {b.repeat, b.hires, {}};
+        out->write((const char *)&r, sizeof(r));
+        out->write((const char *)b.rows, sizeof(b.rows));
+        return;
+    }
+
+    uint8_t colors[3][4];
+    for (size_t n = 0; n < 4; n++) {
+        uint8_t yuv[3];
+        to_yuv(palette[n], yuv);
+        for (size_t p = 0; p < 3; p++)
+            colors[p][n] = yuv[p];
+    }
+
+    // lores pixels cover 2x2 output pixels
+    size_t scale = b.hires ? 1 : 2;
+    size_t w = display_w / scale;
+
+    for (size_t sy = 0; sy < display_h / scale; sy++) {
+        uint8_t index[display_w];
+
+        for (size_t sx = 0; sx < w; sx++) {
+            int bit = 63 - (sx & 63);
+            uint8_t n = (b.rows[0][sy][sx >> 6] >> bit & 0x1) |
+                        (b.rows[1][sy][sx >> 6] >> bit & 0x1) << 1;
+            for (size_t k = 0; k < scale; k++)
+                index[sx * scale + k] = n;
+        }
+
+        for (size_t p = 0; p < 3; p++) {
+            uint8_t *row = &picture[p * picture_size + sy * scale * display_w];
+            for (size_t x = 0; x < display_w; x++)
+                row[x] = colors[p][index[x]];
+            if (scale == 2)
+                memcpy(row + display_w, row, display_w);
+        }
+    }
+
+    for (uint32_t n = 0; n < b.repeat; n++) {
+        *out << "FRAME\n";
+        out->write((const char *)picture.data(), picture.size());
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "chip8.h"
+
+#define capture_magic 0x50433843 // "C8CP"
+#define capture_version 1
+// frame buffers shared between the machine and the writer, a power of two
+#define capture_pool 16
+
+enum capture_format : uint8_t { capture_y4m, capture_raw };
+
+/**
+ * @brief raw capture layout
+ * header  u32 magic, u32 version, u16 width, u16 height, u16 fps,
+ *         u16 planes
+ * frames  u32 repeat, u8 hires, u8 reserved[3], then the framebuffer as
+ *         planes x 64 rows x 2 little-endian u64, shown for repeat frames
+ */
+struct capture_header {
+    uint32_t magic;
+    uint32_t version;
+    uint16_t width;
+    uint16_t height;
+    uint16_t fps;
+    uint16_t planes;
+};
+
+struct capture_record {
+    uint32_t repeat;
+    uint8_t hires;
+    uint8_t reserved[3];
+};
+
+/**
+ * @brief streams the picture of every 60 Hz frame to a file or stdout
+ *
+ * The machine's thread only compares the framebuffer against the last
+ * frame kept: an unchanged frame bumps that frame's repeat count, a
+ * changed one is copied into the next buffer of a fixed ring. A writer
+ * thread turns finished buffers into Y4M (128x64 C444, lores doubled,
+ * repeats written out so the stream stays at 60 fps) or into raw records
+ * that keep the repeat count.
+ */
+class frame_capture
+{
+public:
+    frame_capture() = default;
+    ~frame_capture();
+
+    frame_capture(const frame_capture &) = delete;
+    frame_capture &operator=(const frame_capture &) = delete;
+
+    /**
+     * @brief start writing to path, "-" is stdout, false if it cannot be
+     * opened
+     */
+    bool open(const char *path, capture_format format);
+
+    /**
+     * @brief write out the last frame and stop the writer
+     */
+    void close();
+
+    /**
+     * @brief record what the machine shows now, call once per frame
+     */
+    void frame(const chip8 &c);
+
+private:
+    struct buffer {
+        display_row rows[display_planes][display_h];
+        bool hires;
+        uint32_t repeat;
+    };
+
+    void drain();
+    void write(const buffer &b);
+
+    buffer *pool = nullptr;
+    capture_format format = capture_y4m;
+    std::ofstream file;
+    std::ostream *out = nullptr;
+    std::thread writer;
+    std::atomic<bool> stop{false};
+
+    // y4m pixels of one frame, writer side
+    std::vector<uint8_t> picture;
+
+    // the buffer at head is the newest frame and still counting repeats,
+    // the writer only sees buffers below head
+    bool started = false;
+    alignas(64) std::atomic<size_t> head{0};
+    // bumped after every head or stop change, the writer sleeps on it
+    std::atomic<uint32_t> signal{0};
+    size_t tail_seen = 0;
+    alignas(64) std::atomic<size_t> tail{0};
+};
@@ -0,0 +1,1003 @@
+#include <algorithm>
+#include <cstring>
+
+#include "chip8.h"
+#include "jit.h"
+#include "rom.h"
+#include "trace.h"
+
+static const uint8_t font[80] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80, // F
+};
+
+static const uint8_t big_font[160] = {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0, // F
+};
+
+static void exec_decode(chip8 &c, const instr &d);
+static void fuse(chip8 &c, uint16_t addr);
+static void exec_nop(chip8 &c, const instr &d);
+static void exec_cls(chip8 &c, const instr &d);
+static void exec_ret(chip8 &c, const instr &d);
+static void exec_jp(chip8 &c, const instr &d);
+static void exec_call(chip8 &c, const instr &d);
+static void exec_se_imm(chip8 &c, const instr &d);
+static void exec_sne_imm(chip8 &c, const instr &d);
+static void exec_se_reg(chip8 &c, const instr &d);
+static void exec_ld_imm(chip8 &c, const instr &d);
+static void exec_add_imm(chip8 &c, const instr &d);
+static void exec_ld_reg(chip8 &c, const instr &d);
+template <quirk_profile P>
+static void exec_or(chip8 &c, const instr &d);
+template <quirk_profile P>
+static void exec_and(chip8 &c, const instr &d);
+template <quirk_profile P>
+static void exec_xor(chip8 &c, const instr &d);
+static void exec_add_reg(chip8 &c, const instr &d);
+static void exec_sub(chip8 &c, const instr &d);
+template <quirk_profile P>
+static void exec_shr(chip8 &c, const instr &d);
+static void exec_subn(chip8 &c, const instr &d);
+template <quirk_profile P>
+static void exec_shl(chip8 &c, const instr &d);
+static void exec_sne_reg(chip8 &c, const instr &d);
+static void exec_ld_i(chip8 &c, const instr &d);
+template <quirk_profile P>
+static void exec_jp_v0(chip8 &c, const instr &d);
+static void exec_rnd(chip8 &c, const instr &d);
+template <quirk_profile P>
+static void exec_drw(chip8 &c, const instr &d);
+static void exec_skp(chip8 &c, const instr &d);
+static void exec_sknp(chip8 &c, const instr &d);
+static void exec_ld_vx_dt(chip8 &c, const instr &d);
+static void exec_ld_vx_k(chip8 &c, const instr &d);
+static void exec_ld_dt(chip8 &c, const instr &d);
+static void exec_ld_st(chip8 &c, const instr &d);
+static void exec_add_i(chip8 &c, const instr &d);
+static void exec_ld_f(chip8 &c, const instr &d);
+static void exec_ld_b(chip8 &c, const instr &d);
+template <quirk_profile P>
+static void exec_ld_mem(chip8 &c, const instr &d);
+template <quirk_profile P>
+static void exec_ld_regs(chip8 &c, const instr &d);
+static void exec_scd(chip8 &c, const instr &d);
+static void exec_scu(chip8 &c, const instr &d);
+static void exec_scr(chip8 &c, const instr &d);
+static void exec_scl(chip8 &c, const instr &d);
+static void exec_exit(chip8 &c, const instr &d);
+static void exec_low(chip8 &c, const instr &d);
+static void exec_high(chip8 &c, const instr &d);
+static void exec_save(chip8 &c, const instr &d);
+static void exec_load(chip8 &c, const instr &d);
+static void exec_ld_i_long(chip8 &c, const instr &d);
+static void exec_plane(chip8 &c, const instr &d);
+static void exec_audio(chip8 &c, const instr &d);
+static void exec_pitch(chip8 &c, const instr &d);
+static void exec_ld_hf(chip8 &c, const instr &d);
+static void exec_ld_r(chip8 &c, const instr &d);
+static void exec_ld_vx_r(chip8 &c, const instr &d);
+
+static size_t fused_check(chip8 &c, const instr &d);
+template <quirk_profile P>
+static size_t fused_ld_i_drw(chip8 &c, const instr &d);
+template <quirk_profile P>
+static size_t fused_ld_f_drw(chip8 &c, const instr &d);
+template <bool equal>
+static size_t fused_add_skip_jp(chip8 &c, const instr &d);
+template <size_t count>
+static size_t fused_ld_imm(chip8 &c, const instr &d);
+
+/**
+ * @brief jump table indexed by instr::op, order matches the op enum, one
+ * instance per quirk profile
+ */
+template <quirk_profile P>
+static const handler handlers[op_count] = {
+    exec_decode,    exec_nop,       exec_cls,       exec_ret,
+    exec_jp,        exec_call,      exec_se_imm,    exec_sne_imm,
+    exec_se_reg,    exec_ld_imm,    exec_add_imm,   exec_ld_reg,
+    exec_or<P>,     exec_and<P>,    exec_xor<P>,    exec_add_reg,
+    exec_sub,       exec_shr<P>,    exec_subn,      exec_shl<P>,
+    exec_sne_reg,   exec_ld_i,      exec_jp_v0<P>,  exec_rnd,
+    exec_drw<P>,    exec_skp,       exec_sknp,      exec_ld_vx_dt,
+    exec_ld_vx_k,   exec_ld_dt,     exec_ld_st,     exec_add_i,
+    exec_ld_f,      exec_ld_b,      exec_ld_mem<P>, exec_ld_regs<P>,
+    exec_scd,       exec_scu,       exec_scr,       exec_scl,
+    exec_exit,      exec_low,       exec_high,      exec_save,
+    exec_load,      exec_ld_i_long, exec_plane,     exec_audio,
+    exec_pitch,     exec_ld_hf,     exec_ld_r,      exec_ld_vx_r,
+};
+
+static const handler *const tables[quirks_count] = {
+    handlers<quirks_modern>,
+    handlers<quirks_vip>,
+    handlers<quirks_schip>,
+    handlers<quirks_xochip>,
+};
+
+/**
+ * @brief fused sequences indexed by instr::fused, order matches the fuse
+ * enum, one instance per quirk profile
+ */
+template <quirk_profile P>
+static const fused_handler fused_handlers[fuse_count] = {
+    nullptr,
+    fused_check,
+    fused_ld_i_drw<P>,
+    fused_ld_f_drw<P>,
+    fused_add_skip_jp<true>,
+    fused_add_skip_jp<false>,
+    fused_ld_imm<2>,
+    fused_ld_imm<3>,
+    fused_ld_imm<4>,
+};
+
+// the most instructions each sequence runs, step() needs room for all
+static const uint8_t fused_length[fuse_count] = {1, 1, 2, 2, 3, 3, 2, 3, 4};
+
+static const fused_handler *const fused_tables[quirks_count] = {
+    fused_handlers<quirks_modern>,
+    fused_handlers<quirks_vip>,
+    fused_handlers<quirks_schip>,
+    fused_handlers<quirks_xochip>,
+};
+
+bool find_profile(const char *name, quirk_profile &profile)
+{
+    for (uint8_t p = 0; p < quirks_count; p++)
+        if (strcmp(name, quirk_sets[p].name) == 0) {
+            profile = (quirk_profile)p;
+            return true;
+        }
+
+    return false;
+}
+
+chip8::chip8()
+    : ops(tables[quirks_modern]), fused_ops(fused_tables[quirks_modern])
+{
+    // set up fonts in memory
+    memcpy(mem + font_addr, font, sizeof(font));
+    memcpy(mem + big_font_addr, big_font, sizeof(big_font));
+}
+
+chip8::~chip8() { delete jit; }
+
+bool chip8::load(const char *path)
+{
+    mapped_file f;
+    return f.open(path) && load(f.data(), f.size());
+}
+
+bool chip8::load(const uint8_t *rom, size_t size)
+{
+    if (size > rom_max)
+        return false;
+
+    memcpy(mem + entry_point, rom, size);
+    rom_end = entry_point + size;
+    invalidate(0x0, 4096);
+    return true;
+}
+
+void chip8::tick()
+{
+    if (delay > 0)
+        delay--;
+
+    if (sound > 0)
+        sound--;
+}
+
+void chip8::seed(uint64_t value) { rng = rng_seed(value); }
+
+uint8_t chip8::random() { return rng_next(rng); }
+
+void chip8::set_profile(quirk_profile p)
+{
+    profile = p;
+    ops = tables[p];
+    fused_ops = fused_tables[p];
+
+    // decodes are the same in every profile, translations are not
+    if (jit)
+        jit->invalidate(0x0, 4096);
+}
+
+bool chip8::use_jit(bool enable)
+{
+    delete jit;
+    jit = nullptr;
+
+    if (!enable)
+        return true;
+
+    // translated blocks would bypass the per-instruction counters
+    profiled(return false;)
+
+    jit = new recompiler(*this);
+    if (!jit->ok()) {
+        delete jit;
+        jit = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+size_t chip8::run(size_t budget)
+{
+    size_t done = 0;
+    idle = idle_none;
+
+    if (trace)
+        for (; done < budget && !halted(); done++) {
+            uint16_t at = pc & 0xFFF;
+            uint16_t opcode = mem[at] << 8 | mem[(at + 1) & 0xFFF];
+            uint8_t before[16];
+            memcpy(before, v, sizeof(v));
+
+            step();
+            trace->record(at, opcode, i, before, v);
+        }
+    else
+        while (done < budget && !halted()) {
+            // nothing in an idle loop depends on the cycle count, skipping
+            // it leaves the machine as running it would
+            if (size_t skipped = skip_idle(budget - done)) {
+                done += skipped;
+                break;
+            }
+
+            size_t end = std::min(budget, done + idle_window);
+            if (jit)
+                done += jit->run(end - done);
+            else
+                while (done < end && !halted())
+                    done += step(end - done);
+        }
+
+    cycles += done;
+    return done;
+}
+
+static instr decode_at(const chip8 &c, uint16_t addr)
+{
+    return decode(c.mem[addr & 0xFFF] | c.mem[(addr + 1) & 0xFFF] << 8);
+}
+
+size_t chip8::skip_idle(size_t budget)
+{
+    idle = idle_none;
+
+    if (budget == 0 || halted())
+        return 0;
+
+    instr d = decode_at(*this, pc);
+
+    if (d.op == op_jp && d.nnn == pc) {
+        idle = idle_self;
+        return budget;
+    }
+
+    // keys only change between calls to run()
+    if (d.op == op_ld_vx_k) {
+        for (uint8_t k = 0x0; k <= 0xF; k++)
+            if (keypad[k] == 0xFF)
+                return 0;
+
+        idle = idle_key;
+        return budget;
+    }
+
+    // find the FX07 heading the timer loop pc is in, if it is in one
+    uint16_t start;
+    if (d.op == op_ld_vx_dt)
+        start = pc;
+    else if (d.op == op_se_imm)
+        start = pc - 0x2;
+    else if (d.op == op_jp && d.nnn == pc - 0x4)
+        start = d.nnn;
+    else
+        return 0;
+
+    instr load = decode_at(*this, start);
+    instr skip = decode_at(*this, start + 0x2);
+    instr jump = decode_at(*this, start + 0x4);
+
+    if (load.op != op_ld_vx_dt || skip.op != op_se_imm ||
+        skip.x != load.x || jump.op != op_jp || jump.nnn != start ||
+        start + 0x4u >= rom_end || delay == skip.nn)
+        return 0;
+
+    // position within the loop, entering at the 3XNN compares a stale vx
+    size_t at = (pc - start) / 2;
+    if (at == 1 && v[skip.x] == skip.nn)
+        return 0;
+
+    // the loop leaves vx = delay behind once its FX07 has run
+    if (budget > (3 - at) % 3)
+        v[load.x] = delay;
+    pc = start + 2 * ((at + budget) % 3);
+
+    idle = idle_timer;
+    return budget;
+}
+
+void chip8::step()
+{
+    const instr &d = cache[pc & 0xFFF];
+    profiled(prof.ops[d.op]++; prof.pc_hits[pc & 0xFFF]++;)
+    pc += 0x2;
+    ops[d.op](*this, d);
+}
+
+size_t chip8::step(size_t room)
+{
+    const instr &d = cache[pc & 0xFFF];
+    pc += 0x2;
+
+    // never overshoot the budget, timers tick on exact cycle counts
+    if (d.fused && fused_length[d.fused] <= room)
+        return fused_ops[d.fused](*this, d);
+
+    profiled(prof.ops[d.op]++; prof.pc_hits[(pc - 0x2) & 0xFFF]++;)
+    ops[d.op](*this, d);
+    return 1;
+}
+
+uint16_t chip8::fetch()
+{
+    uint16_t opcode = *(uint16_t *)&mem[pc];
+    pc += 0x2;
+    return opcode;
+}
+
+void chip8::exec(uint16_t opcode)
+{
+    instr d = decode(opcode);
+    ops[d.op](*this, d);
+}
+
+void chip8::exec(const instr &d) { ops[d.op](*this, d); }
+
+void chip8::invalidate(uint16_t addr, size_t len)
+{
+    // the instruction starting one byte earlier also reads addr, fused
+    // sequences starting further back check their instructions when run.
+    // Operands stay put, the handler writing here may still be reading them
+    for (size_t a = addr + 0xFFF; a < addr + 0x1000 + len; a++) {
+        cache[a & 0xFFF].op = op_decode;
+        cache[a & 0xFFF].fused = fuse_none;
+    }
+
+    if (jit)
+        jit->invalidate(addr, len);
+}
+
+instr decode(uint16_t opcode)
+{
+    opcode = (opcode >> 8) | (opcode << 8); // little-endian to big-endian
+
+    instr d;
+    d.x = (opcode & 0xF00) >> 8;
+    d.y = (opcode & 0xF0) >> 4;
+    d.n = (opcode & 0xF);
+    d.nn = (opcode & 0xFF);
+    d.nnn = (opcode & 0xFFF);
+    d.op = op_nop;
+
+    switch (opcode >> 12) {
+    case 0x0:
+        if (opcode == 0xEE)
+            d.op = op_ret;
+        else if (opcode == 0xE0)
+            d.op = op_cls;
+        else if ((opcode & 0xFFF0) == 0xC0)
+            d.op = op_scd;
+        else if ((opcode & 0xFFF0) == 0xD0)
+            d.op = op_scu;
+        else if (opcode == 0xFB)
+            d.op = op_scr;
+        else if (opcode == 0xFC)
+            d.op = op_scl;
+        else if (opcode == 0xFD)
+            d.op = op_exit;
+        else if (opcode == 0xFE)
+            d.op = op_low;
+        else if (opcode == 0xFF)
+            d.op = op_high;
+        break;
+    case 0x1:
+        d.op = op_jp;
+        break;
+    case 0x2:
+        d.op = op_call;
+        break;
+    case 0x3:
+        d.op = op_se_imm;
+        break;
+    case 0x4:
+        d.op = op_sne_imm;
+        break;
+    case 0x5:
+        if (d.n == 0x0)
+            d.op = op_se_reg;
+        else if (d.n == 0x2)
+            d.op = op_save;
+        else if (d.n == 0x3)
+            d.op = op_load;
+        break;
+    case 0x6:
+        d.op = op_ld_imm;
+        break;
+    case 0x7:
+        d.op = op_add_imm;
+        break;
+    case 0x8:
+        if (d.n == 0x0)
+            d.op = op_ld_reg;
+        else if (d.n == 0x1)
+            d.op = op_or;
+        else if (d.n == 0x2)
+            d.op = op_and;
+        else if (d.n == 0x3)
+            d.op = op_xor;
+        else if (d.n == 0x4)
+            d.op = op_add_reg;
+        else if (d.n == 0x5)
+            d.op = op_sub;
+        else if (d.n == 0x6)
+            d.op = op_shr;
+        else if (d.n == 0x7)
+            d.op = op_subn;
+        else if (d.n == 0xE)
+            d.op = op_shl;
+        break;
+    case 0x9:
+        d.op = op_sne_reg;
+        break;
+    case 0xa:
+        d.op = op_ld_i;
+        break;
+    case 0xb:
+        d.op = op_jp_v0;
+        break;
+    case 0xc:
+        d.op = op_rnd;
+        break;
+    case 0xd:
+        d.op = op_drw;
+        break;
+    case 0xe:
+        if (d.nn == 0x9e)
+            d.op = op_skp;
+        else if (d.nn == 0xa1)
+            d.op = op_sknp;
+        break;
+    case 0xf:
+        if (opcode == 0xF000)
+            d.op = op_ld_i_long;
+        else if (opcode == 0xF002)
+            d.op = op_audio;
+        else if (d.nn == 0x01)
+            d.op = op_plane;
+        else if (d.nn == 0x0a)
+            d.op = op_ld_vx_k;
+        else if (d.nn == 0x1e)
+            d.op = op_add_i;
+        else if (d.nn == 0x7)
+            d.op = op_ld_vx_dt;
+        else if (d.nn == 0x15)
+            d.op = op_ld_dt;
+        else if (d.nn == 0x18)
+            d.op = op_ld_st;
+        else if (d.nn == 0x29)
+            d.op = op_ld_f;
+        else if (d.nn == 0x33)
+            d.op = op_ld_b;
+        else if (d.nn == 0x55)
+            d.op = op_ld_mem;
+        else if (d.nn == 0x65)
+            d.op = op_ld_regs;
+        else if (d.nn == 0x30)
+            d.op = op_ld_hf;
+        else if (d.nn == 0x3a)
+            d.op = op_pitch;
+        else if (d.nn == 0x75)
+            d.op = op_ld_r;
+        else if (d.nn == 0x85)
+            d.op = op_ld_vx_r;
+        break;
+    }
+
+    return d;
+}
+
+static void exec_decode(chip8 &c, const instr &)
+{
+    // first visit since the slot was loaded or written, pc is already past it
+    uint16_t addr = (c.pc - 0x2) & 0xFFF;
+    uint16_t opcode = c.mem[addr] | (c.mem[(addr + 1) & 0xFFF] << 8);
+    instr &d = c.cache[addr];
+    d = decode(opcode);
+    fuse(c, addr);
+    c.ops[d.op](c, d);
+}
+
+/**
+ * @brief mark the instruction just decoded at addr if it heads a sequence
+ * with a fused handler
+ */
+static void fuse(chip8 &c, uint16_t addr)
+{
+    instr &d = c.cache[addr];
+    d.fused = fuse_none;
+
+    // profiling counts every instruction on its own
+    profiled(return;)
+
+    // reaching rom_end halts, a sequence must end before it
+    size_t room = addr < c.rom_end ? (c.rom_end - addr) / 2 : 0;
+    room = std::min<size_t>(room, max_fused);
+
+    instr next[max_fused];
+
+    // the instructions after the first are decoded into the cache as well,
+    // jumping into the middle of a sequence runs them one by one
+    for (size_t k = 1; k < room; k++) {
+        instr &e = c.cache[(addr + 2 * k) & 0xFFF];
+        if (e.op == op_decode) {
+            e = decode_at(c, addr + 2 * k);
+            e.fused = fuse_unchecked;
+        }
+        next[k] = e;
+    }
+
+    if (room < 2)
+        return;
+
+    if (d.op == op_ld_i && next[1].op == op_drw)
+        d.fused = fuse_ld_i_drw;
+    else if (d.op == op_ld_f && next[1].op == op_drw)
+        d.fused = fuse_ld_f_drw;
+    else if (d.op == op_add_imm && room >= 3 && next[2].op == op_jp) {
+        if (next[1].op == op_se_imm)
+            d.fused = fuse_add_se_jp;
+        else if (next[1].op == op_sne_imm)
+            d.fused = fuse_add_sne_jp;
+    } else if (d.op == op_ld_imm && next[1].op == op_ld_imm) {
+        size_t run = 2;
+        while (run < room && next[run].op == op_ld_imm)
+            run++;
+        d.fused = fuse_ld_imm2 + run - 2;
+    }
+}
+
+static void exec_nop(chip8 &, const instr &) {}
+
+static void exec_cls(chip8 &c, const instr &)
+{
+    clear_planes(c.framebuffer, c.planes, c.dirty);
+}
+
+static void exec_ret(chip8 &c, const instr &)
+{
+    c.pc = c.mem[--c.sp] << 8;
+    c.pc |= c.mem[--c.sp];
+}
+
+static void exec_jp(chip8 &c, const instr &d) { c.pc = d.nnn; }
+
+static void exec_call(chip8 &c, const instr &d)
+{
+    c.invalidate(c.sp, 2);
+    c.mem[c.sp++] = c.pc & 0xFF;
+    c.mem[c.sp++] = (c.pc & 0xFF00) >> 8;
+    c.pc = d.nnn;
+}
+
+/**
+ * @brief step pc over the next instruction, F000 NNNN is four bytes long
+ */
+static void skip(chip8 &c)
+{
+    bool wide = c.mem[c.pc & 0xFFF] == 0xF0 && c.mem[(c.pc + 1) & 0xFFF] == 0x0;
+    c.pc += wide ? 0x4 : 0x2;
+}
+
+static void exec_se_imm(chip8 &c, const instr &d)
+{
+    if (c.v[d.x] == d.nn)
+        skip(c);
+}
+
+static void exec_sne_imm(chip8 &c, const instr &d)
+{
+    if (c.v[d.x] != d.nn)
+        skip(c);
+}
+
+static void exec_se_reg(chip8 &c, const instr &d)
+{
+    if (c.v[d.x] == c.v[d.y])
+        skip(c);
+}
+
+static void exec_ld_imm(chip8 &c, const instr &d) { c.v[d.x] = d.nn; }
+
+static void exec_add_imm(chip8 &c, const instr &d) { c.v[d.x] += d.nn; }
+
+static void exec_ld_reg(chip8 &c, const instr &d) { c.v[d.x] = c.v[d.y]; }
+
+template <quirk_profile P>
+static void exec_or(chip8 &c, const instr &d)
+{
+    c.v[d.x] |= c.v[d.y];
+    if constexpr (quirk_sets[P].logic_vf)
+        c.v[0xF] = 0x0;
+}
+
+template <quirk_profile P>
+static void exec_and(chip8 &c, const instr &d)
+{
+    c.v[d.x] &= c.v[d.y];
+    if constexpr (quirk_sets[P].logic_vf)
+        c.v[0xF] = 0x0;
+}
+
+template <quirk_profile P>
+static void exec_xor(chip8 &c, const instr &d)
+{
+    c.v[d.x] ^= c.v[d.y];
+    if constexpr (quirk_sets[P].logic_vf)
+        c.v[0xF] = 0x0;
+}
+
+static void exec_add_reg(chip8 &c, const instr &d)
+{
+    if ((c.v[d.x] + c.v[d.y]) > 0xFF)
+        c.v[0xF] = 0x1;
+    else
+        c.v[0xF] = 0x0;
+    c.v[d.x] += c.v[d.y];
+}
+
+static void exec_sub(chip8 &c, const instr &d)
+{
+    if (c.v[d.x] > c.v[d.y])
+        c.v[0xF] = 0x1;
+    else
+        c.v[0xF] = 0x0;
+    c.v[d.x] -= c.v[d.y];
+}
+
+template <quirk_profile P>
+static void exec_shr(chip8 &c, const instr &d)
+{
+    uint8_t src = quirk_sets[P].shift_vy ? d.y : d.x;
+    c.v[0xF] = c.v[src] & 0x1;
+    c.v[d.x] = c.v[src] >> 1;
+}
+
+static void exec_subn(chip8 &c, const instr &d)
+{
+    if (c.v[d.x] < c.v[d.y])
+        c.v[0xF] = 0x1;
+    else
+        c.v[0xF] = 0x0;
+    c.v[d.x] = c.v[d.y] - c.v[d.x];
+}
+
+template <quirk_profile P>
+static void exec_shl(chip8 &c, const instr &d)
+{
+    uint8_t src = quirk_sets[P].shift_vy ? d.y : d.x;
+    c.v[0xF] = (c.v[src] & 0x80) >> 7;
+    c.v[d.x] = c.v[src] << 1;
+}
+
+static void exec_sne_reg(chip8 &c, const instr &d)
+{
+    if (c.v[d.x] != c.v[d.y])
+        skip(c);
+}
+
+static void exec_ld_i(chip8 &c, const instr &d) { c.i = d.nnn; }
+
+template <quirk_profile P>
+static void exec_jp_v0(chip8 &c, const instr &d)
+{
+    c.pc = c.v[quirk_sets[P].jump_vx ? d.x : 0x0] + d.nnn;
+}
+
+static void exec_rnd(chip8 &c, const instr &d)
+{
+    c.v[d.x] = c.random() & d.nn;
+}
+
+template <quirk_profile P>
+static void exec_drw(chip8 &c, const instr &d)
+{
+    c.v[0xF] = draw_sprite<quirk_sets[P].edge>(c.mem, c.dirty, c.framebuffer,
+                                               c.planes, c.hires, c.i,
+                                               c.v[d.x], c.v[d.y], d.n);
+}
+
+static void exec_skp(chip8 &c, const instr &d)
+{
+    if (c.keypad[c.v[d.x]] == 0xFF)
+        skip(c);
+}
+
+static void exec_sknp(chip8 &c, const instr &d)
+{
+    if (c.keypad[c.v[d.x]] != 0xFF)
+        skip(c);
+}
+
+static void exec_ld_vx_dt(chip8 &c, const instr &d) { c.v[d.x] = c.delay; }
+
+static void exec_ld_vx_k(chip8 &c, const instr &d)
+{
+    for (uint8_t k = 0x0; k <= 0xF; k++) {
+        if (c.keypad[k] == 0xFF) {
+            c.v[d.x] = k;
+            return;
+        }
+    }
+    c.pc -= 0x2;
+}
+
+static void exec_ld_dt(chip8 &c, const instr &d) { c.delay = c.v[d.x]; }
+
+static void exec_ld_st(chip8 &c, const instr &d) { c.sound = c.v[d.x]; }
+
+static void exec_add_i(chip8 &c, const instr &d) { c.i += c.v[d.x]; }
+
+static void exec_ld_f(chip8 &c, const instr &d)
+{
+    c.i = font_addr + c.v[d.x] * 5;
+}
+
+static void exec_ld_b(chip8 &c, const instr &d)
+{
+    uint8_t bcd = c.v[d.x];
+    c.invalidate(c.i, 3);
+    c.mem[(c.i + 0x2) & 0xFFF] = bcd % 10;
+    bcd /= 10;
+    c.mem[(c.i + 0x1) & 0xFFF] = bcd % 10;
+    bcd /= 10;
+    c.mem[(c.i + 0x0) & 0xFFF] = bcd % 10;
+}
+
+template <quirk_profile P>
+static void exec_ld_mem(chip8 &c, const instr &d)
+{
+    c.invalidate(c.i, d.x + 1);
+    for (size_t j = 0; j <= d.x; j++)
+        c.mem[(c.i + j) & 0xFFF] = c.v[j];
+    if constexpr (quirk_sets[P].load_i)
+        c.i += d.x + 1;
+}
+
+template <quirk_profile P>
+static void exec_ld_regs(chip8 &c, const instr &d)
+{
+    for (size_t j = 0; j <= d.x; j++)
+        c.v[j] = c.mem[(c.i + j) & 0xFFF];
+    if constexpr (quirk_sets[P].load_i)
+        c.i += d.x + 1;
+}
+
+/**
+ * @brief apply a scroll kernel to every selected plane, amounts are in
+ * pixels of the current resolution
+ */
+template <typename F> static void scroll(chip8 &c, F kernel)
+{
+    size_t h = c.hires ? display_h : display_h / 2;
+    for (size_t p = 0; p < display_planes; p++)
+        if (c.planes & (1 << p))
+            kernel(c.framebuffer[p], h);
+    c.dirty = ~0ull;
+}
+
+static void exec_scd(chip8 &c, const instr &d)
+{
+    scroll(c, [&](display_row *rows, size_t h) { scroll_down(rows, h, d.n); });
+}
+
+static void exec_scu(chip8 &c, const instr &d)
+{
+    scroll(c, [&](display_row *rows, size_t h) { scroll_up(rows, h, d.n); });
+}
+
+static void exec_scr(chip8 &c, const instr &)
+{
+    scroll(c, [&](display_row *rows, size_t h) {
+        scroll_right(rows, h, c.hires);
+    });
+}
+
+static void exec_scl(chip8 &c, const instr &)
+{
+    scroll(c, [&](display_row *rows, size_t h) {
+        scroll_left(rows, h, c.hires);
+    });
+}
+
+static void exec_exit(chip8 &c, const instr &) { c.pc = c.rom_end; }
+
+static void set_hires(chip8 &c, bool hires)
+{
+    // switching resolution clears every plane
+    c.hires = hires;
+    memset(c.framebuffer, 0x0, sizeof(c.framebuffer));
+    c.dirty = ~0ull;
+}
+
+static void exec_low(chip8 &c, const instr &) { set_hires(c, false); }
+
+static void exec_high(chip8 &c, const instr &) { set_hires(c, true); }
+
+static void exec_save(chip8 &c, const instr &d)
+{
+    // vx through vy, counting down when x > y, i is left alone
+    size_t n = (d.x > d.y ? d.x - d.y : d.y - d.x) + 1;
+    int step = d.x > d.y ? -1 : 1;
+    c.invalidate(c.i, n);
+    for (size_t j = 0; j < n; j++)
+        c.mem[(c.i + j) & 0xFFF] = c.v[d.x + step * (int)j];
+}
+
+static void exec_load(chip8 &c, const instr &d)
+{
+    size_t n = (d.x > d.y ? d.x - d.y : d.y - d.x) + 1;
+    int step = d.x > d.y ? -1 : 1;
+    for (size_t j = 0; j < n; j++)
+        c.v[d.x + step * (int)j] = c.mem[(c.i + j) & 0xFFF];
+}
+
+static void exec_ld_i_long(chip8 &c, const instr &)
+{
+    // the address is the next word, pc is already pointing at it
+    c.i = c.mem[c.pc & 0xFFF] << 8 | c.mem[(c.pc + 1) & 0xFFF];
+    c.pc += 0x2;
+}
+
+static void exec_plane(chip8 &c, const instr &d) { c.planes = d.x & 0x3; }
+
+static void exec_audio(chip8 &c, const instr &)
+{
+    for (size_t j = 0; j < 16; j++)
+        c.pattern[j] = c.mem[(c.i + j) & 0xFFF];
+}
+
+static void exec_pitch(chip8 &c, const instr &d) { c.pitch = c.v[d.x]; }
+
+static void exec_ld_hf(chip8 &c, const instr &d)
+{
+    c.i = big_font_addr + (c.v[d.x] & 0xF) * 10;
+}
+
+static void exec_ld_r(chip8 &c, const instr &d)
+{
+    memcpy(c.flags, c.v, d.x + 1);
+}
+
+static void exec_ld_vx_r(chip8 &c, const instr &d)
+{
+    memcpy(c.v, c.flags, d.x + 1);
+}
+
+static size_t fused_check(chip8 &c, const instr &d)
+{
+    // d is a reference into the cache, fuse() may change it
+    fuse(c, (c.pc - 0x2) & 0xFFF);
+    c.ops[d.op](c, d);
+    return 1;
+}
+
+/**
+ * @brief an instruction after the first was written since the sequence
+ * was fused, run the first one alone and look at it again next time
+ */
+static size_t unfuse(chip8 &c, const instr &d)
+{
+    c.cache[(c.pc - 0x2) & 0xFFF].fused = fuse_unchecked;
+    c.ops[d.op](c, d);
+    return 1;
+}
+
+template <quirk_profile P>
+static size_t fused_ld_i_drw(chip8 &c, const instr &d)
+{
+    const instr &draw = c.cache[c.pc & 0xFFF];
+    if (draw.op != op_drw)
+        return unfuse(c, d);
+
+    c.pc += 0x2;
+    exec_ld_i(c, d);
+    exec_drw<P>(c, draw);
+    return 2;
+}
+
+template <quirk_profile P>
+static size_t fused_ld_f_drw(chip8 &c, const instr &d)
+{
+    const instr &draw = c.cache[c.pc & 0xFFF];
+    if (draw.op != op_drw)
+        return unfuse(c, d);
+
+    c.pc += 0x2;
+    exec_ld_f(c, d);
+    exec_drw<P>(c, draw);
+    return 2;
+}
+
+template <bool equal>
+static size_t fused_add_skip_jp(chip8 &c, const instr &d)
+{
+    const instr &test = c.cache[c.pc & 0xFFF];
+    const instr &jump = c.cache[(c.pc + 0x2) & 0xFFF];
+    if (test.op != (equal ? op_se_imm : op_sne_imm) || jump.op != op_jp)
+        return unfuse(c, d);
+
+    c.v[d.x] += d.nn;
+
+    // the skipped instruction is the 1NNN, never the wide F000 NNNN
+    if ((c.v[test.x] == test.nn) == equal) {
+        c.pc += 0x4;
+        return 2;
+    }
+
+    c.pc = jump.nnn;
+    return 3;
+}
+
+template <size_t count>
+static size_t fused_ld_imm(chip8 &c, const instr &d)
+{
+    // the cache has a slot per byte, the next instructions are every other
+    const instr *next = &c.cache[c.pc & 0xFFF];
+    for (size_t k = 0; k < 2 * (count - 1); k += 2)
+        if (next[k].op != op_ld_imm)
+            return unfuse(c, d);
+
+    c.v[d.x] = d.nn;
+    for (size_t k = 0; k < 2 * (count - 1); k += 2)
+        c.v[next[k].x] = next[k].nn;
+    c.pc += 2 * (count - 1);
+    return count;
+}
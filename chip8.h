@@ -0,0 +1,348 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "display.h"
+#include "profile.h"
+
+#define entry_point 0x200
+#define font_addr 0xE50
+#define big_font_addr 0xF00
+#define default_ipf 11
+// nanoseconds in one 60 Hz frame
+#define frame_ns (1000000000 / 60)
+
+// instructions run between checks for an idle loop
+#define idle_window 1024
+
+struct chip8;
+class recompiler;
+class tracer;
+
+/**
+ * @brief handler index of a decoded instruction, op_decode marks a slot that
+ * has not been decoded since it was last written
+ */
+enum : uint8_t {
+    op_decode,
+    op_nop,
+    op_cls,
+    op_ret,
+    op_jp,
+    op_call,
+    op_se_imm,
+    op_sne_imm,
+    op_se_reg,
+    op_ld_imm,
+    op_add_imm,
+    op_ld_reg,
+    op_or,
+    op_and,
+    op_xor,
+    op_add_reg,
+    op_sub,
+    op_shr,
+    op_subn,
+    op_shl,
+    op_sne_reg,
+    op_ld_i,
+    op_jp_v0,
+    op_rnd,
+    op_drw,
+    op_skp,
+    op_sknp,
+    op_ld_vx_dt,
+    op_ld_vx_k,
+    op_ld_dt,
+    op_ld_st,
+    op_add_i,
+    op_ld_f,
+    op_ld_b,
+    op_ld_mem,
+    op_ld_regs,
+    op_scd,
+    op_scu,
+    op_scr,
+    op_scl,
+    op_exit,
+    op_low,
+    op_high,
+    op_save,
+    op_load,
+    op_ld_i_long,
+    op_plane,
+    op_audio,
+    op_pitch,
+    op_ld_hf,
+    op_ld_r,
+    op_ld_vx_r,
+    op_count,
+};
+
+/**
+ * @brief superinstruction a decoded instruction heads, run in one go in
+ * place of it and the instructions after it
+ * fuse_unchecked   decoded ahead as part of another sequence, looked at
+ *                  as the start of one the first time it runs
+ * fuse_ld_i_drw    ANNN DXYN
+ * fuse_ld_f_drw    FX29 DXYN
+ * fuse_add_se_jp   7XNN 3XNN 1NNN, a loop counter
+ * fuse_add_sne_jp  7XNN 4XNN 1NNN
+ * fuse_ld_imm2-4   runs of 6XNN
+ */
+enum : uint8_t {
+    fuse_none,
+    fuse_unchecked,
+    fuse_ld_i_drw,
+    fuse_ld_f_drw,
+    fuse_add_se_jp,
+    fuse_add_sne_jp,
+    fuse_ld_imm2,
+    fuse_ld_imm3,
+    fuse_ld_imm4,
+    fuse_count,
+};
+
+// most instructions a fused sequence covers
+#define max_fused 4
+
+/**
+ * @brief an instruction with its operands pulled out, cached per address,
+ * fused is set on the first instruction of a sequence found when it was
+ * decoded, the others keep their own plain decode
+ */
+struct instr {
+    uint8_t op = op_decode;
+    uint8_t x, y, n, nn;
+    uint8_t fused = fuse_none;
+    uint16_t nnn;
+};
+
+/**
+ * @brief the interpreter variants a rom can be written for, each one runs
+ * its own instance of the handlers, so quirks cost nothing at run time
+ */
+enum quirk_profile : uint8_t {
+    quirks_modern,
+    quirks_vip,
+    quirks_schip,
+    quirks_xochip,
+    quirks_count,
+};
+
+struct quirk_set {
+    const char *name;
+    bool shift_vy; // 8XY6 / 8XYE shift vy into vx instead of vx itself
+    bool load_i;   // FX55 / FX65 leave i past the last register
+    bool logic_vf; // 8XY1 / 8XY2 / 8XY3 clear vf
+    bool jump_vx;  // BXNN jumps to XNN + vx instead of NNN + v0
+    draw_edge edge;
+};
+
+inline constexpr quirk_set quirk_sets[quirks_count] = {
+    {"modern", false, false, false, false, edge_linear},
+    {"vip", true, true, true, false, edge_clip},
+    {"schip", false, false, false, true, edge_clip},
+    {"xochip", true, true, false, false, edge_wrap},
+};
+
+/**
+ * @brief look a profile up by name, false if there is none
+ */
+bool find_profile(const char *name, quirk_profile &profile);
+
+/**
+ * @brief runs one decoded instruction, pc already points past it
+ */
+typedef void (*handler)(chip8 &, const instr &);
+
+/**
+ * @brief runs a fused sequence, pc already points past its first
+ * instruction, returns the instructions executed since a skip can end the
+ * sequence early
+ */
+typedef size_t (*fused_handler)(chip8 &, const instr &);
+
+/**
+ * @brief xorshift64* behind CXNN, rng_seed() spreads a seed over a valid
+ * state, equal seeds give equal sequences
+ */
+inline uint64_t rng_seed(uint64_t value)
+{
+    // splitmix64, xorshift must never be seeded with zero
+    uint64_t z = value + 0x9E3779B97F4A7C15;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return (z ^ (z >> 31)) | 0x1;
+}
+
+inline uint8_t rng_next(uint64_t &state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (state * 0x2545F4914F6CDD1D) >> 56;
+}
+
+/**
+ * @brief what the rom was found spinning on, set by chip8::run()
+ * idle_timer  FX07, 3XNN, 1NNN back to the FX07 until delay reaches NN
+ * idle_key    FX0A with no key held
+ * idle_self   1NNN jumping to itself
+ */
+enum idle_reason : uint8_t { idle_none, idle_timer, idle_key, idle_self };
+
+/**
+ * @brief memory layout
+ * start   end   name
+ * 0x200 - 0xE4F .text,
+ * 0xE50 - 0xE9F .data,
+ * 0xEA0 - 0xEFF .stack,
+ * 0xF00 - 0xF9F .bigfont (FX30)
+ *
+ * F000 NNNN can only reach the same 4 KiB, addresses wrap at 0xFFF
+ */
+
+struct chip8 {
+    uint8_t mem[4096] = {};
+    // one bit per pixel per plane, row y of plane p is framebuffer[p][y],
+    // lores only uses rows 0 - 31
+    display_row framebuffer[display_planes][display_h] = {};
+
+    // rows touched since the frontend last cleared this, everything starts
+    // dirty so the first frame gets uploaded
+    uint64_t dirty = ~0ull;
+
+    uint8_t v[16] = {};
+    uint16_t i = 0x0;
+    uint16_t pc = entry_point;
+    uint16_t sp = 0xEA0;
+
+    uint8_t delay = 0;
+    uint8_t sound = 0;
+    uint8_t keypad[16] = {};
+
+    // 128x64 after 00FF, 64x32 after 00FE
+    bool hires = false;
+
+    // planes 00E0, scrolls and DXYN work on, set by FN01
+    uint8_t planes = 0x1;
+
+    // XO-CHIP sound, a 128 bit pattern loaded by F002 played at
+    // 4000 * 2 ^ ((pitch - 64) / 48) bits per second, pitch set by FX3A
+    uint8_t pattern[16] = {0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F,
+                           0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F};
+    uint8_t pitch = 64;
+
+    // SCHIP persistent flags behind FX75 and FX85
+    uint8_t flags[16] = {};
+
+    size_t rom_end = entry_point;
+
+    // instructions executed so far, the time base for recorded input
+    uint64_t cycles = 0;
+
+    // xorshift64* state behind CXNN, set through seed()
+    uint64_t rng = 0x9E3779B97F4A7C15;
+
+    // predecoded instruction for every byte address, pc may be odd
+    instr cache[4096];
+
+    // x86-64 translation of hot code, null when interpreting
+    recompiler *jit = nullptr;
+
+    // receives every instruction run() executes, owned by the caller,
+    // takes precedence over the recompiler while set
+    tracer *trace = nullptr;
+
+    // idle loop the last run() fast-forwarded through, nothing changes
+    // until the next tick() or keypad update once this is set
+    idle_reason idle = idle_none;
+
+    // handler table of the quirk profile, set through set_profile()
+    quirk_profile profile = quirks_modern;
+    const handler *ops;
+    const fused_handler *fused_ops;
+
+    profiled(::profile prof;)
+
+    chip8();
+    ~chip8();
+
+    chip8(const chip8 &) = delete;
+    chip8 &operator=(const chip8 &) = delete;
+
+    /**
+     * @brief map a rom file and load it at the entry point, false if it
+     * cannot be read, is empty or overruns .text
+     */
+    bool load(const char *path);
+
+    /**
+     * @brief load a rom image from memory, false if it overruns .text
+     */
+    bool load(const uint8_t *rom, size_t size);
+
+    /**
+     * @brief the rom has run off its end or exited through 00FD
+     */
+    bool halted() const { return pc >= rom_end; }
+
+    /**
+     * @brief count the delay and sound timers down, call at 60 Hz
+     */
+    void tick();
+
+    /**
+     * @brief reseed CXNN, equal seeds give equal random sequences
+     */
+    void seed(uint64_t value);
+    uint8_t random();
+
+    /**
+     * @brief run the rom with another variant's quirks from now on
+     */
+    void set_profile(quirk_profile p);
+
+    /**
+     * @brief switch between the interpreter and the recompiler, false if
+     * the recompiler is not available on this host
+     */
+    bool use_jit(bool enable);
+
+    /**
+     * @brief run up to budget instructions, stops early once halted, idle
+     * loops are skipped to the end of the budget with the state they
+     * would have left behind
+     */
+    size_t run(size_t budget);
+
+    /**
+     * @brief fast-forward through budget instructions if pc sits in an
+     * idle loop, returns the instructions skipped, 0 or budget
+     */
+    size_t skip_idle(size_t budget);
+
+    /**
+     * @brief run the instruction at pc through the predecoded cache
+     */
+    void step();
+
+    /**
+     * @brief like step(), but run the whole sequence when pc heads a fused
+     * one no longer than room, returns the instructions executed
+     */
+    size_t step(size_t room);
+
+    uint16_t fetch();
+    void exec(uint16_t opcode);
+    void exec(const instr &d);
+
+    /**
+     * @brief drop cached decodes overlapping a write to [addr, addr + len)
+     */
+    void invalidate(uint16_t addr, size_t len);
+};
+
+instr decode(uint16_t opcode);
@@ -0,0 +1,295 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "input_log.h"
+#include "stream.h"
+
+/**
+ * @brief one connection and the frames its deltas may refer to, frame n
+ * kept in views[n % (stream_window + 1)]
+ */
+struct connection {
+    int fd;
+    bool greeted = false;
+    std::vector<uint8_t> in;
+
+    struct view {
+        uint32_t frame;
+        uint8_t rows[stream_frame_size];
+    } views[stream_window + 1] = {};
+    uint32_t latest = 0;
+};
+
+static int connect_to(const std::string &address);
+static bool send_input(int fd, const stream_input &msg);
+static bool receive(connection &c, uint64_t &updates, uint64_t &bytes,
+                    uint64_t &mismatches);
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: <path|host:port> [--sessions <n>] "
+                     "[--frames <n>] [--seed <n>]\n"
+                     "       [--input <script>]"
+                  << std::endl;
+        return 1;
+    }
+
+    size_t count = 1;
+    uint64_t max_frames = 600;
+    uint64_t seed = 0;
+    std::vector<key_event> script;
+
+    for (int arg = 2; arg < argc; arg++) {
+        std::string opt = argv[arg];
+        if (opt == "--sessions" && arg + 1 < argc)
+            count = std::stoul(argv[++arg]);
+        else if (opt == "--frames" && arg + 1 < argc)
+            max_frames = std::stoull(argv[++arg]);
+        else if (opt == "--seed" && arg + 1 < argc)
+            seed = std::stoull(argv[++arg]);
+        else if (opt == "--input" && arg + 1 < argc) {
+            if (!load_script(argv[++arg], script)) {
+                std::cerr << "Error: invalid input script" << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Error: unknown option " << opt << std::endl;
+            return 1;
+        }
+    }
+
+    if (count == 0) {
+        std::cerr << "Error: sessions must be at least 1" << std::endl;
+        return 1;
+    }
+
+    std::vector<connection> links(count);
+    std::vector<pollfd> polled(count);
+
+    for (size_t n = 0; n < count; n++) {
+        links[n].fd = connect_to(argv[1]);
+
+        // session n runs with seed + n
+        stream_input reset = {input_reset, 0, 0, (uint32_t)(seed + n)};
+
+        if (links[n].fd < 0 || !send_input(links[n].fd, reset)) {
+            std::cerr << "Error: cannot connect to " << argv[1] << std::endl;
+            return 1;
+        }
+
+        polled[n] = {links[n].fd, POLLIN, 0};
+    }
+
+    uint64_t updates = 0;
+    uint64_t bytes = 0;
+    uint64_t mismatches = 0;
+    uint16_t keys = 0;
+    size_t next_event = 0;
+    size_t open = count;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (;;) {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t frame = elapsed / std::chrono::nanoseconds(1000000000 / 60);
+
+        if (frame >= max_frames || open == 0)
+            break;
+
+        uint16_t held = keys;
+
+        for (; next_event < script.size(); next_event++) {
+            const key_event &e = script[next_event];
+            if (e.frame > frame)
+                break;
+            held = e.down ? held | 1 << e.key : held & ~(1 << e.key);
+        }
+
+        if (held != keys) {
+            keys = held;
+            for (connection &c : links)
+                if (c.fd >= 0)
+                    send_input(c.fd, {input_keys, 0, keys, 0});
+        }
+
+        // wake for the next frame boundary at the latest
+        if (poll(polled.data(), count, 1000 / 60) < 0 && errno != EINTR) {
+            std::cerr << "Error: " << strerror(errno) << std::endl;
+            return 1;
+        }
+
+        for (size_t n = 0; n < count; n++) {
+            connection &c = links[n];
+
+            if (c.fd < 0 || !(polled[n].revents & (POLLIN | POLLHUP)))
+                continue;
+
+            if (!receive(c, updates, bytes, mismatches)) {
+                close(c.fd);
+                c.fd = -1;
+                polled[n].fd = -1;
+                open--;
+            }
+        }
+    }
+
+    const connection &first = links[0];
+    const uint8_t *shown =
+        first.views[first.latest % (stream_window + 1)].rows;
+
+    std::cout << std::format("sessions {}\n", count)
+              << std::format("updates {}\n", updates)
+              << std::format("bytes {} ({:.1f} per update)\n", bytes,
+                             updates ? (double)bytes / updates : 0.0)
+              << std::format("mismatches {}\n", mismatches)
+              << std::format("framebuffer {:0>16x}\n", frame_hash(shown));
+
+    for (connection &c : links)
+        if (c.fd >= 0)
+            close(c.fd);
+
+    return mismatches ? 1 : 0;
+}
+
+bool receive(connection &c, uint64_t &updates, uint64_t &bytes,
+             uint64_t &mismatches)
+{
+    uint8_t buffer[16384];
+    ssize_t got = recv(c.fd, buffer, sizeof(buffer), 0);
+
+    if (got <= 0) {
+        if (got == 0)
+            std::cerr << "Error: server closed the connection" << std::endl;
+        return false;
+    }
+
+    c.in.insert(c.in.end(), buffer, buffer + got);
+    size_t used = 0;
+
+    if (!c.greeted) {
+        stream_hello hello;
+
+        if (c.in.size() < sizeof(hello))
+            return true;
+
+        memcpy(&hello, c.in.data(), sizeof(hello));
+        if (hello.magic != stream_magic || hello.version != stream_version ||
+            hello.window > stream_window) {
+            std::cerr << "Error: not a chip8 stream" << std::endl;
+            return false;
+        }
+
+        c.greeted = true;
+        used = sizeof(hello);
+    }
+
+    for (;;) {
+        stream_update u;
+
+        if (c.in.size() - used < sizeof(u))
+            break;
+        memcpy(&u, c.in.data() + used, sizeof(u));
+        if (c.in.size() - used < sizeof(u) + u.size)
+            break;
+
+        const uint8_t *delta = c.in.data() + used + sizeof(u);
+        used += sizeof(u) + u.size;
+
+        auto &base = c.views[u.base % (stream_window + 1)];
+        auto &view = c.views[u.frame % (stream_window + 1)];
+
+        if (base.frame != u.base || u.frame != c.latest + 1) {
+            std::cerr << "Error: update " << u.frame << " against unknown "
+                      << "frame " << u.base << std::endl;
+            return false;
+        }
+
+        if (&view != &base)
+            memcpy(view.rows, base.rows, sizeof(view.rows));
+        view.frame = u.frame;
+
+        if (!apply_delta(view.rows, delta, u.size)) {
+            std::cerr << "Error: malformed update " << u.frame << std::endl;
+            return false;
+        }
+
+        if (frame_hash(view.rows) != u.hash)
+            mismatches++;
+
+        c.latest = u.frame;
+        updates++;
+        bytes += u.size;
+
+        if (!send_input(c.fd, {input_ack, 0, 0, u.frame}))
+            return false;
+    }
+
+    c.in.erase(c.in.begin(), c.in.begin() + used);
+    return true;
+}
+
+int connect_to(const std::string &address)
+{
+    size_t colon = address.rfind(':');
+
+    if (colon == std::string::npos) {
+        sockaddr_un to = {};
+        to.sun_family = AF_UNIX;
+
+        if (address.size() >= sizeof(to.sun_path))
+            return -1;
+        memcpy(to.sun_path, address.c_str(), address.size());
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (sockaddr *)&to, sizeof(to)) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo *found;
+    if (getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(),
+                    &hints, &found) != 0)
+        return -1;
+
+    int fd = socket(found->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, found->ai_addr, found->ai_addrlen) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+
+    int on = 1;
+    if (fd >= 0)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    return fd;
+}
+
+bool send_input(int fd, const stream_input &msg)
+{
+    return send(fd, &msg, sizeof(msg), MSG_NOSIGNAL) == sizeof(msg);
+}
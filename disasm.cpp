@@ -0,0 +1,150 @@
+#include <format>
+
+#include "disasm.h"
+
+std::string disassemble(uint16_t opcode)
+{
+    uint8_t nibble = opcode >> 12;
+
+    if (opcode == 0xEE)
+        return std::format("ret");
+    else if (opcode == 0xE0)
+        return std::format("clear");
+    else if ((opcode & 0xFFF0) == 0xC0)
+        return std::format("scroll down #{:x}", opcode & 0xF);
+    else if ((opcode & 0xFFF0) == 0xD0)
+        return std::format("scroll up #{:x}", opcode & 0xF);
+    else if (opcode == 0xFB)
+        return std::format("scroll right");
+    else if (opcode == 0xFC)
+        return std::format("scroll left");
+    else if (opcode == 0xFD)
+        return std::format("exit");
+    else if (opcode == 0xFE)
+        return std::format("lores");
+    else if (opcode == 0xFF)
+        return std::format("hires");
+    else if (nibble == 0x0)
+        return std::format("0NNN");
+
+    if (nibble == 0x8) {
+        if ((opcode & 0xF) == 0x0)
+            return std::format("mov v{:x} v{:x}", (opcode & 0xF00) >> 8,
+                               (opcode & 0xF0) >> 4);
+        else if ((opcode & 0xF) == 0x1)
+            return std::format("or v{:x} v{:x}", (opcode & 0xF00) >> 8,
+                               (opcode & 0xF0) >> 4);
+        else if ((opcode & 0xF) == 0x2)
+            return std::format("and v{:x} v{:x}", (opcode & 0xF00) >> 8,
+                               (opcode & 0xF0) >> 4);
+        else if ((opcode & 0xF) == 0x3)
+            return std::format("xor v{:x} v{:x}", (opcode & 0xF00) >> 8,
+                               (opcode & 0xF0) >> 4);
+        else if ((opcode & 0xF) == 0x4)
+            return std::format("add v{:x} v{:x}", (opcode & 0xF00) >> 8,
+                               (opcode & 0xF0) >> 4);
+        else if ((opcode & 0xF) == 0x5)
+            return std::format("sub v{:x} v{:x}", (opcode & 0xF00) >> 8,
+                               (opcode & 0xF0) >> 4);
+        else if ((opcode & 0xF) == 0x6)
+            return std::format("shr v{:x}", (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xF) == 0x7)
+            return std::format("sub v{:x} v{:x}; neg v{:x}",
+                               (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4,
+                               (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xF) == 0xE)
+            return std::format("shl v{:x}", (opcode & 0xF00) >> 8);
+    }
+
+    if (nibble == 0x5) {
+        if ((opcode & 0xF) == 0x2)
+            return std::format("save v{:x} - v{:x}", (opcode & 0xF00) >> 8,
+                               (opcode & 0xF0) >> 4);
+        else if ((opcode & 0xF) == 0x3)
+            return std::format("load v{:x} - v{:x}", (opcode & 0xF00) >> 8,
+                               (opcode & 0xF0) >> 4);
+        else if ((opcode & 0xF) != 0x0)
+            return "undefined";
+    }
+
+    if (nibble == 0xe) {
+        if ((opcode & 0xFF) == 0x9e)
+            return std::format("keq");
+        else if ((opcode & 0xFF) == 0xa1)
+            return std::format("knq");
+    }
+
+    if (nibble == 0xf) {
+        if (opcode == 0xF000)
+            return std::format("mov i long");
+        else if (opcode == 0xF002)
+            return std::format("audio");
+        else if ((opcode & 0xFF) == 0x01)
+            return std::format("plane #{:x}", (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xFF) == 0x0a)
+            return std::format("waitk");
+        else if ((opcode & 0xFF) == 0x1e)
+            return std::format("add i v{:x}", (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xFF) == 0x7)
+            return std::format("mov v{:x} delay", (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xFF) == 0x15)
+            return std::format("mov delay v{:x}", (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xFF) == 0x18)
+            return std::format("mov sound v{:x}", (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xFF) == 0x29)
+            return std::format("mov i, font[v{:x}]", (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xFF) == 0x33)
+            return std::format("movbcd v{:x}", (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xFF) == 0x55)
+            return std::format("regdump");
+        else if ((opcode & 0xFF) == 0x65)
+            return std::format("regload");
+        else if ((opcode & 0xFF) == 0x30)
+            return std::format("mov i, bigfont[v{:x}]", (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xFF) == 0x3a)
+            return std::format("pitch v{:x}", (opcode & 0xF00) >> 8);
+        else if ((opcode & 0xFF) == 0x75)
+            return std::format("flagdump");
+        else if ((opcode & 0xFF) == 0x85)
+            return std::format("flagload");
+    }
+
+    switch (nibble) {
+    case 0x1:
+        return std::format("jmp ${:x}", opcode & 0xFFF);
+    case 0x2:
+        return std::format("call ${:x}", opcode & 0xFFF);
+    case 0x3:
+        return std::format("beq v{:x} #{:x}", (opcode & 0xF00) >> 8,
+                           opcode & 0xFF);
+    case 0x4:
+        return std::format("bnq v{:x} #{:x}", (opcode & 0xF00) >> 8,
+                           opcode & 0xFF);
+    case 0x5:
+        return std::format("beq v{:x} v{:x}", (opcode & 0xF00) >> 8,
+                           (opcode & 0xF0) >> 4);
+    case 0x6:
+        return std::format("mov v{:x} #{:x}", (opcode & 0xF00) >> 8,
+                           opcode & 0xFF);
+    case 0x7:
+        return std::format("add v{:x} #{:x}", (opcode & 0xF00) >> 8,
+                           opcode & 0xFF);
+    case 0x9:
+        return std::format("bnq v{:x} v{:x}", (opcode & 0xF00) >> 8,
+                           (opcode & 0xF0) >> 4);
+    case 0xa:
+        return std::format("mov i ${:x}", opcode & 0xFFF);
+    case 0xb:
+        return std::format("add v0 #{:x}; mov pc v0", opcode & 0xFFF);
+    case 0xc:
+        return std::format("rand v{:x} #{:x}", (opcode & 0xF00) >> 8,
+                           opcode & 0xFF);
+    case 0xd:
+        return std::format("draw v{:x} v{:x} #{:x}", (opcode & 0xF00) >> 8,
+                           (opcode & 0xF0) >> 4, opcode & 0xF);
+    default:
+        break;
+    }
+
+    return "undefined";
+}
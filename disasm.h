@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief one line of assembly for a big-endian opcode, "undefined" if it
+ * does not decode
+ */
+std::string disassemble(uint16_t opcode);
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cstring>
+
+#include "display.h"
+
+void clear_planes(display_row (*framebuffer)[display_h], uint8_t planes,
+                  uint64_t &dirty)
+{
+    for (size_t p = 0; p < display_planes; p++) {
+        if (!(planes & (1 << p)))
+            continue;
+        for (size_t row = 0; row < display_h; row++)
+            if (framebuffer[p][row][0] | framebuffer[p][row][1])
+                dirty |= 1ull << row;
+        memset(framebuffer[p], 0x0, sizeof(framebuffer[p]));
+    }
+}
+
+void scroll_down(display_row *rows, size_t height, size_t n)
+{
+    n = std::min(n, height);
+    memmove(rows + n, rows, (height - n) * sizeof(display_row));
+    memset(rows, 0x0, n * sizeof(display_row));
+}
+
+void scroll_up(display_row *rows, size_t height, size_t n)
+{
+    n = std::min(n, height);
+    memmove(rows, rows + n, (height - n) * sizeof(display_row));
+    memset(rows + height - n, 0x0, n * sizeof(display_row));
+}
+
+#if defined(__SSE2__)
+
+// a row is one register, the low lane holds the left word
+
+void scroll_right(display_row *rows, size_t height, bool wide)
+{
+    for (size_t y = 0; y < height; y++) {
+        __m128i r = _mm_loadu_si128((const __m128i *)rows[y]);
+        __m128i moved = _mm_srli_epi64(r, 4);
+        if (wide) // low nibble of the left word into the right one
+            moved = _mm_or_si128(
+                moved, _mm_slli_si128(_mm_slli_epi64(r, 60), 8));
+        _mm_storeu_si128((__m128i *)rows[y], moved);
+    }
+}
+
+void scroll_left(display_row *rows, size_t height, bool wide)
+{
+    for (size_t y = 0; y < height; y++) {
+        __m128i r = _mm_loadu_si128((const __m128i *)rows[y]);
+        __m128i moved = _mm_slli_epi64(r, 4);
+        if (wide)
+            moved = _mm_or_si128(
+                moved, _mm_srli_si128(_mm_srli_epi64(r, 60), 8));
+        _mm_storeu_si128((__m128i *)rows[y], moved);
+    }
+}
+
+#else
+
+void scroll_right(display_row *rows, size_t height, bool wide)
+{
+    for (size_t y = 0; y < height; y++) {
+        if (wide)
+            rows[y][1] = rows[y][1] >> 4 | rows[y][0] << 60;
+        rows[y][0] >>= 4;
+    }
+}
+
+void scroll_left(display_row *rows, size_t height, bool wide)
+{
+    for (size_t y = 0; y < height; y++) {
+        rows[y][0] <<= 4;
+        if (wide) {
+            rows[y][0] |= rows[y][1] >> 60;
+            rows[y][1] <<= 4;
+        }
+    }
+}
+
+#endif
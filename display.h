@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// the hires screen, lores uses the top left 64x32 of it
+#define display_w 128
+#define display_h 64
+// XO-CHIP bit planes, FN01 selects which ones draw, scroll and clear
+#define display_planes 2
+
+/**
+ * @brief one row of one plane, x = 0 in bit 63 of the first word and
+ * x = 64 in bit 63 of the second, lores rows only use the first word
+ */
+typedef uint64_t display_row[2];
+
+/**
+ * @brief RGBA4444 color of each combination of the two planes' bits,
+ * plane 0 in bit 0
+ */
+inline constexpr uint16_t palette[4] = {0x0, 0xBD8D, 0x5ADF, 0xEEEF};
+
+/**
+ * @brief what DXYN does with pixels past the edges
+ * edge_linear  continue on the next row, (y * w + x) % (w * h)
+ * edge_clip    drop them, only the start position wraps
+ * edge_wrap    wrap around to the other side of the same row or column
+ */
+enum draw_edge : uint8_t { edge_linear, edge_clip, edge_wrap };
+
+/**
+ * @brief clear the selected planes (00E0), rows that had pixels set are
+ * marked in dirty
+ */
+void clear_planes(display_row (*framebuffer)[display_h], uint8_t planes,
+                  uint64_t &dirty);
+
+/**
+ * @brief move the first height rows of a plane by n rows, rows scrolled in
+ * are blank (00CN, 00DN)
+ */
+void scroll_down(display_row *rows, size_t height, size_t n);
+void scroll_up(display_row *rows, size_t height, size_t n);
+
+/**
+ * @brief move the first height rows of a plane 4 pixels sideways (00FB,
+ * 00FC), wide rows carry pixels between their two words
+ */
+void scroll_right(display_row *rows, size_t height, bool wide);
+void scroll_left(display_row *rows, size_t height, bool wide);
+
+/**
+ * @brief xor mask into row, true if that turned any pixel off, inline since
+ * DXYN calls it for every sprite row
+ */
+inline bool blit_row(display_row &row, const display_row &mask)
+{
+#if defined(__SSE2__)
+    __m128i r = _mm_loadu_si128((const __m128i *)row);
+    __m128i m = _mm_loadu_si128((const __m128i *)mask);
+    __m128i hit = _mm_and_si128(r, m);
+    _mm_storeu_si128((__m128i *)row, _mm_xor_si128(r, m));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(hit, _mm_setzero_si128())) !=
+           0xFFFF;
+#else
+    bool hit = (row[0] & mask[0]) | (row[1] & mask[1]);
+    row[0] ^= mask[0];
+    row[1] ^= mask[1];
+    return hit;
+#endif
+}
+
+/**
+ * @brief draw rows of sprite data from src into plane, one instance per
+ * resolution, sprite width and edge keeps the row loop free of all three
+ *
+ * with edge_linear pixels land at ((y + j) * w + x + k) % (w * h), so every
+ * row starts in the same column and columns past the right edge continue at
+ * the start of the next row
+ */
+template <bool hires, size_t bytes, draw_edge edge>
+inline bool draw_plane(const uint8_t *mem, uint64_t &dirty,
+                       display_row *plane, uint16_t src, size_t rows,
+                       uint8_t x, uint8_t y)
+{
+    constexpr size_t w = hires ? display_w : display_w / 2;
+    constexpr size_t h = hires ? display_h : display_h / 2;
+    constexpr size_t width = 8 * bytes;
+
+    size_t col = x % w;
+    size_t top = edge == edge_linear ? y + x / w : y % h;
+    size_t over = col + width > w ? col + width - w : 0;
+    size_t end = col % 64 + width;
+    bool hit = false;
+
+    if (edge == edge_clip && rows > h - top)
+        rows = h - top;
+
+    for (size_t j = 0; j < rows; j++, src += bytes) {
+        uint32_t sprite = mem[src & 0xFFF];
+        if (bytes == 2)
+            sprite = sprite << 8 | mem[(src + 1) & 0xFFF];
+
+        if (!sprite)
+            continue;
+
+        size_t row = (top + j) & (h - 1);
+
+        if (end > 64 && !over) {
+            // straddles x = 64, both words at once
+            display_row mask = {sprite >> (end - 64),
+                                (uint64_t)sprite << (128 - end)};
+            hit |= blit_row(plane[row], mask);
+            dirty |= 1ull << row;
+            continue;
+        }
+
+        // otherwise the row sits in one word, or it runs past the right
+        // edge and the part that fits and the part that does not each do
+        size_t at = over ? (w - 1) / 64 : col / 64;
+        uint64_t bits = over ? sprite >> over : (uint64_t)sprite << (64 - end);
+        hit |= (plane[row][at] & bits) != 0;
+        plane[row][at] ^= bits;
+        dirty |= 1ull << row;
+
+        if (over && edge != edge_clip) {
+            // edge_linear carries on in the next row, edge_wrap in this one
+            size_t next = edge == edge_linear ? (row + 1) & (h - 1) : row;
+            uint64_t rest = (uint64_t)sprite << (64 - over);
+            hit |= (plane[next][0] & rest) != 0;
+            plane[next][0] ^= rest;
+            dirty |= 1ull << next;
+        }
+    }
+
+    return hit;
+}
+
+/**
+ * @brief DXYN from mem[src] into the selected planes, each plane takes the
+ * next sprite's worth of data, n = 0 draws 16x16, true on a collision
+ */
+template <draw_edge edge>
+inline bool draw_sprite(const uint8_t *mem, uint64_t &dirty,
+                        display_row (*framebuffer)[display_h], uint8_t planes,
+                        bool hires, uint16_t src, uint8_t x, uint8_t y,
+                        uint8_t n)
+{
+    auto draw = hires ? (n ? draw_plane<true, 1, edge>
+                           : draw_plane<true, 2, edge>)
+                      : (n ? draw_plane<false, 1, edge>
+                           : draw_plane<false, 2, edge>);
+
+    // DXY0 draws 16x16, two bytes a row
+    size_t rows = n ? n : 16;
+    size_t size = n ? n : 32;
+    bool hit = false;
+
+    for (size_t p = 0; p < display_planes; p++)
+        if (planes & (1 << p)) {
+            hit |= draw(mem, dirty, framebuffer[p], src, rows, x, y);
+            src += size;
+        }
+
+    return hit;
+}
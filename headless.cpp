@@ -0,0 +1,268 @@
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "capture.h"
+#include "chip8.h"
+#include "input_log.h"
+#include "rom.h"
+#include "state.h"
+#include "trace.h"
+
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: <filepath> [--cycles <n>] [--frames <n>] "
+                     "[--ipf <n>] [--input <script>] [--jit]\n"
+                     "       [--load-state <path>] [--save-state <path>] "
+                     "[--seed <n>]\n"
+                     "       [--record <log>] [--replay <log>] "
+                     "[--trace <path>]\n"
+                     "       [--library <path>] [--quirks <profile>] "
+                     "[--capture <y4m|->] [--capture-raw <path>]"
+                  << std::endl;
+        return 1;
+    }
+
+    uint64_t max_cycles = 0;
+    uint64_t max_frames = 0;
+    size_t ipf = default_ipf;
+    bool jit = false;
+    const char *load_path = nullptr;
+    const char *save_path = nullptr;
+    const char *record_path = nullptr;
+    const char *replay_path = nullptr;
+    const char *trace_path = nullptr;
+    const char *library_path = nullptr;
+    const char *capture_path = nullptr;
+    capture_format format = capture_y4m;
+    uint64_t seed = 0;
+    quirk_profile profile = quirks_modern;
+    std::vector<key_event> script;
+
+    for (int arg = 2; arg < argc; arg++) {
+        std::string opt = argv[arg];
+        if (opt == "--cycles" && arg + 1 < argc)
+            max_cycles = std::stoull(argv[++arg]);
+        else if (opt == "--frames" && arg + 1 < argc)
+            max_frames = std::stoull(argv[++arg]);
+        else if (opt == "--ipf" && arg + 1 < argc)
+            ipf = std::stoul(argv[++arg]);
+        else if (opt == "--input" && arg + 1 < argc) {
+            if (!load_script(argv[++arg], script)) {
+                std::cerr << "Error: invalid input script" << std::endl;
+                return 1;
+            }
+        } else if (opt == "--jit")
+            jit = true;
+        else if (opt == "--load-state" && arg + 1 < argc)
+            load_path = argv[++arg];
+        else if (opt == "--save-state" && arg + 1 < argc)
+            save_path = argv[++arg];
+        else if (opt == "--seed" && arg + 1 < argc)
+            seed = std::stoull(argv[++arg]);
+        else if (opt == "--record" && arg + 1 < argc)
+            record_path = argv[++arg];
+        else if (opt == "--replay" && arg + 1 < argc)
+            replay_path = argv[++arg];
+        else if (opt == "--trace" && arg + 1 < argc)
+            trace_path = argv[++arg];
+        else if (opt == "--library" && arg + 1 < argc)
+            library_path = argv[++arg];
+        else if (opt == "--capture" && arg + 1 < argc) {
+            capture_path = argv[++arg];
+            format = capture_y4m;
+        } else if (opt == "--capture-raw" && arg + 1 < argc) {
+            capture_path = argv[++arg];
+            format = capture_raw;
+        }
+        else if (opt == "--quirks" && arg + 1 < argc) {
+            if (!find_profile(argv[++arg], profile)) {
+                std::cerr << "Error: unknown quirk profile " << argv[arg]
+                          << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Error: unknown option " << opt << std::endl;
+            return 1;
+        }
+    }
+
+    if (ipf == 0) {
+        std::cerr << "Error: ipf must be at least 1" << std::endl;
+        return 1;
+    }
+
+    input_replay replay;
+
+    if (replay_path) {
+        if (!script.empty() || record_path) {
+            std::cerr << "Error: --replay excludes --input and --record"
+                      << std::endl;
+            return 1;
+        }
+        if (!replay.open(replay_path)) {
+            std::cerr << "Error: invalid input log" << std::endl;
+            return 1;
+        }
+        seed = replay.seed;
+        ipf = replay.ipf;
+        profile = replay.profile;
+    }
+
+    input_recorder recorder;
+
+    if (record_path && !recorder.open(record_path, seed, ipf, profile)) {
+        std::cerr << "Error: cannot write input log" << std::endl;
+        return 1;
+    }
+
+    // one emulated minute unless told otherwise
+    if (max_cycles == 0 && max_frames == 0)
+        max_frames = 3600;
+
+    tracer trace;
+
+    if (trace_path && !trace.open(trace_path)) {
+        std::cerr << "Error: cannot write trace" << std::endl;
+        return 1;
+    }
+
+    frame_capture capture;
+
+    if (capture_path && !capture.open(capture_path, format)) {
+        std::cerr << "Error: cannot write capture" << std::endl;
+        return 1;
+    }
+
+    chip8 machine;
+
+    // with --library the rom is named by file name or by content hash
+    rom_library library;
+
+    if (library_path) {
+        if (!library.open(library_path)) {
+            std::cerr << "Error: invalid library" << std::endl;
+            return 1;
+        }
+
+        const library_entry *e = library.find(std::string_view(argv[1]));
+
+        std::string key = argv[1];
+        if (!e && key.size() == 16 &&
+            key.find_first_not_of("0123456789abcdefABCDEF") ==
+                std::string::npos)
+            e = library.find(std::stoull(key, nullptr, 16));
+
+        if (!e || !machine.load(library.rom(*e), e->size)) {
+            std::cerr << "Error: no rom " << argv[1] << " in library"
+                      << std::endl;
+            return 1;
+        }
+    } else if (!machine.load(argv[1])) {
+        std::cerr << "Error: invalid file" << std::endl;
+        return 1;
+    }
+
+    machine.seed(seed);
+    machine.set_profile(profile);
+
+    if (load_path && !load_state(machine, load_path)) {
+        std::cerr << "Error: invalid state file" << std::endl;
+        return 1;
+    }
+
+    if (jit && !machine.use_jit(true))
+        std::cerr << "Warning: jit unavailable, interpreting" << std::endl;
+
+    if (trace_path)
+        machine.trace = &trace;
+
+    uint64_t cycles = 0;
+    uint64_t frames = 0;
+    size_t next_event = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    while (!machine.halted()) {
+        if (max_frames && frames >= max_frames)
+            break;
+        if (max_cycles && cycles >= max_cycles)
+            break;
+
+        for (; next_event < script.size(); next_event++) {
+            const key_event &e = script[next_event];
+            if (e.frame > frames)
+                break;
+            recorder.press(machine, e.key, e.down);
+        }
+
+        size_t budget = ipf;
+        if (max_cycles && max_cycles - cycles < budget)
+            budget = max_cycles - cycles;
+
+        profiled(profile_timer timer{machine.prof.cpu_ns};)
+        size_t executed;
+
+        if (replay_path)
+            executed = replay.run(machine, budget);
+        else
+            executed = machine.run(budget);
+
+        cycles += executed;
+        profiled(machine.prof.frame(executed);)
+
+        machine.tick();
+        capture.frame(machine);
+        frames++;
+    }
+
+    capture.close();
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+#ifdef CHIP8_PROFILE
+    std::string profile_path = std::string(argv[1]) + ".profile.json";
+    if (!machine.prof.dump(profile_path.c_str()))
+        std::cerr << "Error: cannot write " << profile_path << std::endl;
+#endif
+
+    if (save_path && !save_state(machine, save_path)) {
+        std::cerr << "Error: cannot save state" << std::endl;
+        return 1;
+    }
+
+    uint64_t fb_hash = fnv1a(machine.framebuffer, sizeof(machine.framebuffer));
+
+    uint64_t reg_hash = fnv_basis;
+    reg_hash = fnv1a(machine.v, sizeof(machine.v), reg_hash);
+    reg_hash = fnv1a(&machine.i, sizeof(machine.i), reg_hash);
+    reg_hash = fnv1a(&machine.pc, sizeof(machine.pc), reg_hash);
+    reg_hash = fnv1a(&machine.sp, sizeof(machine.sp), reg_hash);
+    reg_hash = fnv1a(&machine.delay, sizeof(machine.delay), reg_hash);
+    reg_hash = fnv1a(&machine.sound, sizeof(machine.sound), reg_hash);
+
+    uint64_t mem_hash = fnv1a(machine.mem, sizeof(machine.mem));
+
+    // video on stdout leaves the summary to stderr
+    bool piped = capture_path && strcmp(capture_path, "-") == 0;
+    std::ostream &results = piped ? std::cerr : std::cout;
+
+    results << std::format("cycles {}\n", cycles)
+            << std::format("frames {}\n", frames)
+            << std::format("framebuffer {:0>16x}\n", fb_hash)
+            << std::format("registers {:0>16x}\n", reg_hash)
+            << std::format("mem {:0>16x}\n", mem_hash);
+
+    std::cerr << std::format("{:.3f} s, {:.2f} MIPS\n", elapsed.count(),
+                             cycles / elapsed.count() / 1e6);
+
+    return 0;
+}
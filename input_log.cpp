@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+#include "input_log.h"
+
+bool input_recorder::open(const char *path, uint64_t seed, uint32_t ipf,
+                          quirk_profile profile)
+{
+    f.open(path, std::ios::binary);
+
+    if (!f.is_open())
+        return false;
+
+    input_header header = {input_magic, input_version, seed, ipf, profile};
+    f.write((const char *)&header, sizeof(header));
+
+    return f.good();
+}
+
+void input_recorder::press(chip8 &c, uint8_t key, bool down)
+{
+    c.keypad[key] = down ? 0xFF : 0x0;
+
+    if (!f.is_open())
+        return;
+
+    uint64_t delta = c.cycles - last;
+    last = c.cycles;
+
+    do {
+        uint8_t byte = delta & 0x7F;
+        delta >>= 7;
+        f.put(delta ? byte | 0x80 : byte);
+    } while (delta);
+
+    f.put(key | (down ? 0x80 : 0x0));
+}
+
+bool input_replay::open(const char *path)
+{
+    std::ifstream f(path, std::ios::binary);
+
+    if (!f.is_open())
+        return false;
+
+    input_header header;
+
+    if (!f.read((char *)&header, sizeof(header)))
+        return false;
+
+    if (header.magic != input_magic || header.version != input_version ||
+        header.ipf == 0 || header.profile >= quirks_count)
+        return false;
+
+    seed = header.seed;
+    ipf = header.ipf;
+    profile = (quirk_profile)header.profile;
+
+    uint64_t cycle = 0;
+    int byte;
+
+    while ((byte = f.get()) != EOF) {
+        uint64_t delta = 0;
+        for (int shift = 0;; shift += 7) {
+            delta |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                break;
+            if ((byte = f.get()) == EOF || shift > 56)
+                return false;
+        }
+
+        if ((byte = f.get()) == EOF)
+            return false;
+
+        cycle += delta;
+        events.push_back({cycle, (uint8_t)(byte & 0xF), (byte & 0x80) != 0});
+    }
+
+    return true;
+}
+
+size_t input_replay::run(chip8 &c, size_t budget)
+{
+    size_t done = 0;
+
+    apply(c);
+
+    while (done < budget && !c.halted()) {
+        size_t slice = budget - done;
+        if (!this->done() && events[next].cycle - c.cycles < slice)
+            slice = events[next].cycle - c.cycles;
+
+        done += c.run(slice);
+        apply(c);
+    }
+
+    return done;
+}
+
+void input_replay::apply(chip8 &c)
+{
+    for (; next < events.size() && events[next].cycle <= c.cycles; next++)
+        c.keypad[events[next].key] = events[next].down ? 0xFF : 0x0;
+}
+
+bool load_script(const char *path, std::vector<key_event> &script)
+{
+    std::ifstream f(path);
+
+    if (!f.is_open())
+        return false;
+
+    std::string line;
+
+    while (std::getline(f, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        uint64_t frame;
+        unsigned key;
+        std::string state;
+
+        std::istringstream in(line);
+        if (!(in >> frame >> std::hex >> key >> state) || key > 0xF)
+            return false;
+        if (state != "down" && state != "up")
+            return false;
+
+        script.push_back({frame, (uint8_t)key, state == "down"});
+    }
+
+    std::stable_sort(script.begin(), script.end(),
+                     [](const key_event &a, const key_event &b) {
+                         return a.frame < b.frame;
+                     });
+
+    return true;
+}
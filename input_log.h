@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include "chip8.h"
+
+#define input_magic 0x4E493843 // "C8IN"
+#define input_version 1
+
+/**
+ * @brief input log layout
+ * header  u32 magic, u32 version, u64 seed, u32 ipf, u8 quirk profile,
+ *         u8 reserved[3]
+ * events  leb128 cycles since the previous event, u8 key | down << 7
+ */
+struct input_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seed;
+    uint32_t ipf;
+    uint8_t profile;
+    uint8_t reserved[3];
+};
+
+struct input_event {
+    uint64_t cycle;
+    uint8_t key;
+    bool down;
+};
+
+/**
+ * @brief scripted keypad input, one "<frame> <key> <down|up>" per line,
+ * frames counted at 60 Hz from the start of the run
+ */
+struct key_event {
+    uint64_t frame;
+    uint8_t key;
+    bool down;
+};
+
+/**
+ * @brief read a key script sorted by frame, false if it cannot be read or
+ * a line is malformed, blank lines and lines starting with # are skipped
+ */
+bool load_script(const char *path, std::vector<key_event> &script);
+
+/**
+ * @brief appends keypad transitions to a log file as they are applied
+ */
+class input_recorder
+{
+public:
+    bool open(const char *path, uint64_t seed, uint32_t ipf,
+              quirk_profile profile);
+
+    /**
+     * @brief set a key on the machine and log it at the current cycle
+     */
+    void press(chip8 &c, uint8_t key, bool down);
+
+private:
+    std::ofstream f;
+    uint64_t last = 0;
+};
+
+/**
+ * @brief feeds a recorded log back into a machine at the recorded cycles
+ */
+class input_replay
+{
+public:
+    bool open(const char *path);
+
+    /**
+     * @brief run like chip8::run, stopping at each logged cycle to apply
+     * the key transitions recorded there
+     */
+    size_t run(chip8 &c, size_t budget);
+
+    /**
+     * @brief apply every event due at or before the current cycle
+     */
+    void apply(chip8 &c);
+
+    bool done() const { return next == events.size(); }
+
+    uint64_t seed = 0;
+    uint32_t ipf = default_ipf;
+    quirk_profile profile = quirks_modern;
+
+private:
+    std::vector<input_event> events;
+    size_t next = 0;
+};
@@ -0,0 +1,420 @@
+#include <cstring>
+#include <initializer_list>
+
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+
+#define code_size (1 << 20)
+#define max_block 32
+#define max_block_code 4096
+
+/**
+ * @brief little x86-64 assembler, rbx holds the chip8 pointer throughout
+ */
+struct emitter {
+    uint8_t *p;
+    const chip8 &c;
+
+    void byte(uint8_t b) { *p++ = b; }
+
+    void bytes(std::initializer_list<uint8_t> bs)
+    {
+        for (uint8_t b : bs)
+            *p++ = b;
+    }
+
+    template <class T> void imm(T value)
+    {
+        memcpy(p, &value, sizeof(T));
+        p += sizeof(T);
+    }
+
+    // [rbx + disp32] operand for a field of the machine, reg in modrm.reg
+    void field(uint8_t reg, const void *addr)
+    {
+        byte(0x83 | (reg << 3));
+        imm<int32_t>((const uint8_t *)addr - (const uint8_t *)&c);
+    }
+
+    const void *v(uint8_t x) const { return &c.v[x]; }
+
+    void mov_al(const void *src) // mov al, [src]
+    {
+        byte(0x8A);
+        field(0, src);
+    }
+
+    void store_al(const void *dst) // mov [dst], al
+    {
+        byte(0x88);
+        field(0, dst);
+    }
+
+    void store_cl(const void *dst) // mov [dst], cl
+    {
+        byte(0x88);
+        field(1, dst);
+    }
+
+    void alu_al(uint8_t opcode, const void *src) // op al, [src]
+    {
+        byte(opcode);
+        field(0, src);
+    }
+
+    void movzx_eax(const void *src) // movzx eax, byte [src]
+    {
+        bytes({0x0F, 0xB6});
+        field(0, src);
+    }
+
+    void store16(const void *dst, uint16_t value) // mov word [dst], imm16
+    {
+        bytes({0x66, 0xC7});
+        field(0, dst);
+        imm<uint16_t>(value);
+    }
+
+    void set_pc(uint16_t value) { store16(&c.pc, value); }
+
+    // if the condition code holds, skip the store bumping pc past the skip,
+    // next is the length of the instruction after it
+    void skip_unless(uint8_t jcc, uint16_t addr, uint16_t next)
+    {
+        set_pc(addr + 0x2);
+        bytes({jcc, 9});
+        set_pc(addr + 0x2 + next);
+    }
+
+    void call(const instr *d) // chip8::exec(*d) through exec_callback
+    {
+        void (*fn)(chip8 *, const instr *) = [](chip8 *c, const instr *d) {
+            c->exec(*d);
+        };
+        bytes({0x48, 0x89, 0xDF}); // mov rdi, rbx
+        bytes({0x48, 0xBE});       // mov rsi, imm64
+        imm<uint64_t>((uint64_t)d);
+        bytes({0x48, 0xB8}); // mov rax, imm64
+        imm<uint64_t>((uint64_t)fn);
+        bytes({0xFF, 0xD0}); // call rax
+    }
+
+    void ret() { bytes({0x5B, 0xC3}); } // pop rbx; ret
+};
+
+/**
+ * @brief bytes taken by the instruction at addr, F000 NNNN takes four
+ */
+static uint16_t length_at(const chip8 &c, uint16_t addr)
+{
+    bool wide = c.mem[addr & 0xFFF] == 0xF0 && c.mem[(addr + 1) & 0xFFF] == 0x0;
+    return wide ? 0x4 : 0x2;
+}
+
+recompiler::recompiler(chip8 &c) : c(c)
+{
+    void *p = mmap(nullptr, code_size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED)
+        code = (uint8_t *)p;
+}
+
+recompiler::~recompiler()
+{
+    if (code)
+        munmap(code, code_size);
+}
+
+size_t recompiler::run(size_t cycles)
+{
+    size_t done = 0;
+
+    while (done < cycles && !c.halted()) {
+        block &b = blocks[c.pc];
+        if (!b.fn)
+            compile(c.pc);
+
+        // never overshoot the budget, timers tick on exact cycle counts
+        if (b.count > cycles - done) {
+            c.step();
+            done++;
+            continue;
+        }
+
+        // a block writing over its own code drops itself while it runs
+        size_t n = b.count;
+        b.fn(&c);
+        done += n;
+    }
+
+    return done;
+}
+
+void recompiler::invalidate(uint16_t addr, size_t len)
+{
+    addr &= 0xFFF;
+
+    // writes past the top of memory wrap around to 0x0
+    if (addr + len > 0x1000) {
+        invalidate(0x0, addr + len - 0x1000);
+        len = 0x1000 - addr;
+    }
+
+    bool hit = false;
+
+    for (size_t a = addr; a < addr + len; a++)
+        hit |= covered[a] != 0;
+
+    if (!hit)
+        return;
+
+    // a block never spans more than max_block instructions plus the opcode
+    // a final skip peeks at, one starting near the top of memory ends past
+    // 0xFFF and reads the bytes its end wraps around to
+    size_t lo = addr;
+    size_t hi = addr + len;
+    size_t reach = 2 * max_block + 2;
+
+    for (size_t s = lo + 0x1000 - reach; s < hi + 0x1000; s++) {
+        size_t start = s & 0xFFF;
+        block &b = blocks[start];
+        bool over = start < hi && b.end > lo;
+        bool wrapped = b.end > lo + 0x1000;
+        if (!b.fn || !(over || wrapped))
+            continue;
+        for (size_t a = start; a < b.end; a++)
+            covered[a & 0xFFF]--;
+        b = block();
+    }
+}
+
+void recompiler::flush()
+{
+    for (block &b : blocks)
+        b = block();
+    memset(covered, 0, sizeof(covered));
+    used = 0;
+}
+
+void recompiler::compile(uint16_t start)
+{
+    if (code_size - used < max_block_code)
+        flush();
+
+    emitter e{code + used, c};
+    uint8_t *entry = e.p;
+
+    e.byte(0x53);                   // push rbx
+    e.bytes({0x48, 0x89, 0xFB});    // mov rbx, rdi
+
+    uint16_t addr = start;
+    uint16_t count = 0;
+    bool open = true;
+
+    // blocks are flushed when the profile changes, so bake its quirks in
+    const quirk_set &q = quirk_sets[c.profile];
+
+    // skips look at the next opcode to step over F000 NNNN whole, the
+    // block then depends on those bytes too
+    uint16_t peek = 0;
+
+    while (open) {
+        if (addr >= c.rom_end || count == max_block) {
+            e.set_pc(addr);
+            break;
+        }
+
+        uint16_t opcode = c.mem[addr] | (c.mem[(addr + 1) & 0xFFF] << 8);
+        const instr &d = decoded[addr] = decode(opcode);
+        count++;
+        uint16_t next = length_at(c, addr + 0x2);
+
+        switch (d.op) {
+        case op_nop:
+            break;
+        case op_jp:
+            e.set_pc(d.nnn);
+            open = false;
+            break;
+        case op_se_imm:
+        case op_sne_imm:
+            e.bytes({0x80}); // cmp byte [vx], imm8
+            e.field(7, e.v(d.x));
+            e.imm<uint8_t>(d.nn);
+            e.skip_unless(d.op == op_se_imm ? 0x75 : 0x74, addr, next);
+            peek = 0x2;
+            open = false;
+            break;
+        case op_se_reg:
+        case op_sne_reg:
+            e.mov_al(e.v(d.x));
+            e.alu_al(0x3A, e.v(d.y)); // cmp al, [vy]
+            e.skip_unless(d.op == op_se_reg ? 0x75 : 0x74, addr, next);
+            peek = 0x2;
+            open = false;
+            break;
+        case op_ld_imm:
+            e.byte(0xC6); // mov byte [vx], imm8
+            e.field(0, e.v(d.x));
+            e.imm<uint8_t>(d.nn);
+            break;
+        case op_add_imm:
+            e.byte(0x80); // add byte [vx], imm8
+            e.field(0, e.v(d.x));
+            e.imm<uint8_t>(d.nn);
+            break;
+        case op_ld_reg:
+            e.mov_al(e.v(d.y));
+            e.store_al(e.v(d.x));
+            break;
+        case op_or:
+        case op_and:
+        case op_xor:
+            e.mov_al(e.v(d.y));
+            // or/and/xor [vx], al
+            e.byte(d.op == op_or ? 0x08 : d.op == op_and ? 0x20 : 0x30);
+            e.field(0, e.v(d.x));
+            if (q.logic_vf) {
+                e.byte(0xC6); // mov byte [vf], 0
+                e.field(0, e.v(0xF));
+                e.imm<uint8_t>(0x0);
+            }
+            break;
+        case op_add_reg:
+            // vf is written before the sum, exactly like the interpreter
+            e.mov_al(e.v(d.x));
+            e.alu_al(0x02, e.v(d.y));      // add al, [vy]
+            e.bytes({0x0F, 0x92, 0xC1});   // setc cl
+            e.store_cl(e.v(0xF));
+            e.mov_al(e.v(d.x));
+            e.alu_al(0x02, e.v(d.y));
+            e.store_al(e.v(d.x));
+            break;
+        case op_sub:
+            e.mov_al(e.v(d.x));
+            e.alu_al(0x3A, e.v(d.y));      // cmp al, [vy]
+            e.bytes({0x0F, 0x97, 0xC1});   // seta cl
+            e.store_cl(e.v(0xF));
+            e.mov_al(e.v(d.x));
+            e.alu_al(0x2A, e.v(d.y));      // sub al, [vy]
+            e.store_al(e.v(d.x));
+            break;
+        case op_subn:
+            e.mov_al(e.v(d.x));
+            e.alu_al(0x3A, e.v(d.y));
+            e.bytes({0x0F, 0x92, 0xC1});   // setb cl
+            e.store_cl(e.v(0xF));
+            e.mov_al(e.v(d.y));
+            e.alu_al(0x2A, e.v(d.x));
+            e.store_al(e.v(d.x));
+            break;
+        case op_shr:
+        case op_shl: {
+            // vf is written before the result, exactly like the interpreter
+            const void *src = e.v(q.shift_vy ? d.y : d.x);
+            e.mov_al(src);
+            if (d.op == op_shr)
+                e.bytes({0x24, 0x01});     // and al, 1
+            else
+                e.bytes({0xC0, 0xE8, 0x07}); // shr al, 7
+            e.store_al(e.v(0xF));
+            e.mov_al(src);
+            // shr al, 1 / shl al, 1
+            e.bytes({0xD0, (uint8_t)(d.op == op_shr ? 0xE8 : 0xE0)});
+            e.store_al(e.v(d.x));
+            break;
+        }
+        case op_ld_i:
+            e.store16(&c.i, d.nnn);
+            break;
+        case op_add_i:
+            e.movzx_eax(e.v(d.x));
+            e.byte(0x66); // add word [i], ax
+            e.byte(0x01);
+            e.field(0, &c.i);
+            break;
+        case op_ld_f:
+            e.movzx_eax(e.v(d.x));
+            e.bytes({0x8D, 0x04, 0x80}); // lea eax, [rax + rax * 4]
+            e.byte(0x05);                // add eax, imm32
+            e.imm<uint32_t>(font_addr);
+            e.byte(0x66); // mov word [i], ax
+            e.byte(0x89);
+            e.field(0, &c.i);
+            break;
+        case op_ld_vx_dt:
+            e.mov_al(&c.delay);
+            e.store_al(e.v(d.x));
+            break;
+        case op_ld_dt:
+            e.mov_al(e.v(d.x));
+            e.store_al(&c.delay);
+            break;
+        case op_ld_st:
+            e.mov_al(e.v(d.x));
+            e.store_al(&c.sound);
+            break;
+        case op_cls:
+        case op_rnd:
+        case op_drw:
+        case op_ld_regs:
+        case op_scd:
+        case op_scu:
+        case op_scr:
+        case op_scl:
+        case op_low:
+        case op_high:
+        case op_load:
+        case op_plane:
+        case op_audio:
+        case op_pitch:
+        case op_ld_hf:
+        case op_ld_r:
+        case op_ld_vx_r:
+            // no control flow and no writes to mem, stay in the block
+            e.call(&d);
+            break;
+        default:
+            // control flow, key waits and writes to mem leave the block
+            e.set_pc(addr + 0x2);
+            e.call(&d);
+            open = false;
+            break;
+        }
+
+        addr += 0x2;
+    }
+
+    e.ret();
+    used += e.p - entry;
+
+    uint16_t end = addr + peek;
+    for (size_t a = start; a < end; a++)
+        covered[a & 0xFFF]++;
+
+    blocks[start] = {(void (*)(chip8 *))entry, end, count};
+}
+
+#else
+
+recompiler::recompiler(chip8 &c) : c(c) {}
+
+recompiler::~recompiler() {}
+
+size_t recompiler::run(size_t cycles)
+{
+    size_t done = 0;
+    for (; done < cycles && !c.halted(); done++)
+        c.step();
+    return done;
+}
+
+void recompiler::invalidate(uint16_t, size_t) {}
+
+void recompiler::flush() {}
+
+void recompiler::compile(uint16_t) {}
+
+#endif
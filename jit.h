@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chip8.h"
+
+/**
+ * @brief basic-block recompiler from chip-8 to x86-64
+ *
+ * Straight-line runs of instructions are translated once into native code
+ * that works directly on the machine state, ending at the first jump, call,
+ * return, skip or memory write. Opcodes without a native translation call
+ * back into the interpreter handlers, so results match step() exactly.
+ */
+class recompiler
+{
+public:
+    explicit recompiler(chip8 &c);
+    ~recompiler();
+
+    /**
+     * @brief the host can run generated code
+     */
+    bool ok() const { return code != nullptr; }
+
+    /**
+     * @brief run up to cycles instructions, returns how many ran
+     */
+    size_t run(size_t cycles);
+
+    /**
+     * @brief drop blocks translated from [addr, addr + len)
+     */
+    void invalidate(uint16_t addr, size_t len);
+
+private:
+    struct block {
+        void (*fn)(chip8 *) = nullptr;
+        uint16_t end = 0;
+        uint16_t count = 0;
+    };
+
+    void compile(uint16_t start);
+    void flush();
+
+    chip8 &c;
+
+    block blocks[4096];
+    uint16_t covered[4096] = {}; // blocks reading each byte
+    instr decoded[4096];         // operands for interpreter callbacks
+
+    uint8_t *code = nullptr;
+    size_t used = 0;
+};
@@ -0,0 +1,58 @@
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "keymap.h"
+
+keymap::keymap()
+{
+    static const SDL_Scancode layout[16] = {
+        SDL_SCANCODE_X, SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3,
+        SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_A,
+        SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_Z, SDL_SCANCODE_C,
+        SDL_SCANCODE_4, SDL_SCANCODE_R, SDL_SCANCODE_F, SDL_SCANCODE_V,
+    };
+
+    memset(keys, key_none, sizeof(keys));
+    for (uint8_t k = 0x0; k <= 0xF; k++)
+        keys[layout[k]] = k;
+}
+
+bool keymap::load(const char *path)
+{
+    std::ifstream f(path);
+
+    if (!f.is_open())
+        return false;
+
+    memset(keys, key_none, sizeof(keys));
+
+    std::string line;
+    while (std::getline(f, line)) {
+        line = line.substr(0, line.find('#'));
+
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            continue;
+
+        size_t gap = line.find_first_of(" \t", first);
+        size_t name = line.find_first_not_of(" \t", gap);
+        size_t last = line.find_last_not_of(" \t\r");
+
+        if (gap != first + 1 || name == std::string::npos ||
+            !isxdigit(line[first]))
+            return false;
+
+        uint8_t key = std::stoul(line.substr(first, 1), nullptr, 16);
+        SDL_Scancode code = SDL_GetScancodeFromName(
+            line.substr(name, last + 1 - name).c_str());
+
+        if (code == SDL_SCANCODE_UNKNOWN)
+            return false;
+
+        keys[code] = key;
+    }
+
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+#include <SDL3/SDL.h>
+
+// keymap entry for a scancode that is not bound to the keypad
+#define key_none 0xFF
+
+/**
+ * @brief scancode to keypad lookup, one table read per key event
+ */
+struct keymap {
+    uint8_t keys[SDL_SCANCODE_COUNT];
+
+    /**
+     * @brief the COSMAC VIP keypad on 1234 / QWER / ASDF / ZXCV by position
+     */
+    keymap();
+
+    /**
+     * @brief replace the bindings with "<key> <scancode name>" lines, e.g.
+     * "c 4" or "0 Keypad 0", # starts a comment, false on a bad line
+     */
+    bool load(const char *path);
+
+    uint8_t operator[](SDL_Scancode code) const
+    {
+        return code < SDL_SCANCODE_COUNT ? keys[code] : key_none;
+    }
+};
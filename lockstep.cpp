@@ -0,0 +1,1021 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "lockstep.h"
+
+/**
+ * @brief runs one instruction for the lanes set in group, all of them sat
+ * at the same pc and have been moved past it
+ */
+typedef void (*lane_handler)(lockstep &m, const instr &d, uint32_t group);
+
+#if defined(__SSE2__)
+
+// 16 byte lanes or 8 word lanes of a register file row, compares give all
+// ones in the lanes that hold
+
+typedef __m128i vec;
+
+static inline vec vload(const void *p)
+{
+    return _mm_load_si128((const __m128i *)p);
+}
+
+static inline void vstore(void *p, vec a) { _mm_store_si128((__m128i *)p, a); }
+
+static inline vec splat8(uint8_t a) { return _mm_set1_epi8(a); }
+static inline vec splat16(uint16_t a) { return _mm_set1_epi16(a); }
+
+static inline vec vand(vec a, vec b) { return _mm_and_si128(a, b); }
+static inline vec vandnot(vec a, vec b) { return _mm_andnot_si128(a, b); }
+static inline vec vor(vec a, vec b) { return _mm_or_si128(a, b); }
+static inline vec vxor(vec a, vec b) { return _mm_xor_si128(a, b); }
+
+static inline vec add8(vec a, vec b) { return _mm_add_epi8(a, b); }
+static inline vec sub8(vec a, vec b) { return _mm_sub_epi8(a, b); }
+static inline vec subs8(vec a, vec b) { return _mm_subs_epu8(a, b); }
+static inline vec max8(vec a, vec b) { return _mm_max_epu8(a, b); }
+static inline vec eq8(vec a, vec b) { return _mm_cmpeq_epi8(a, b); }
+
+// bytes shifted right without bits crossing into the next byte
+template <int n> static inline vec shr8(vec a)
+{
+    return vand(_mm_srli_epi16(a, n), splat8(0xFF >> n));
+}
+
+static inline vec add16(vec a, vec b) { return _mm_add_epi16(a, b); }
+static inline vec subs16(vec a, vec b) { return _mm_subs_epu16(a, b); }
+static inline vec eq16(vec a, vec b) { return _mm_cmpeq_epi16(a, b); }
+static inline vec min16(vec a, vec b) { return _mm_min_epi16(a, b); }
+static inline vec max16(vec a, vec b) { return _mm_max_epi16(a, b); }
+
+// the 8 bytes at p zero extended to words
+static inline vec widen(const uint8_t *p)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p),
+                             _mm_setzero_si128());
+}
+
+static inline vec blend(vec mask, vec a, vec b)
+{
+    return vor(vand(mask, a), vandnot(mask, b));
+}
+
+// byte j all ones when bit j is set, and the other way round
+static inline vec mask8(uint16_t bits)
+{
+    vec bit = _mm_set1_epi64x(0x8040201008040201);
+    vec b = _mm_set_epi64x((bits >> 8) * 0x0101010101010101ull,
+                           (bits & 0xFF) * 0x0101010101010101ull);
+    return eq8(vand(b, bit), bit);
+}
+
+static inline uint16_t bits8(vec mask) { return _mm_movemask_epi8(mask); }
+
+// word j all ones when bit j is set, and the other way round
+static inline vec mask16(uint8_t bits)
+{
+    vec bit = _mm_set_epi16(0x80, 0x40, 0x20, 0x10, 0x8, 0x4, 0x2, 0x1);
+    return eq16(vand(splat16(bits), bit), bit);
+}
+
+static inline uint8_t bits16(vec mask)
+{
+    return _mm_movemask_epi8(_mm_packs_epi16(mask, _mm_setzero_si128()));
+}
+
+// lowest and highest word as signed numbers
+static inline uint16_t lowest16(vec a)
+{
+    a = min16(a, _mm_shuffle_epi32(a, 0x4E));
+    a = min16(a, _mm_shuffle_epi32(a, 0xB1));
+    a = min16(a, _mm_shufflelo_epi16(a, 0xB1));
+    return _mm_extract_epi16(a, 0);
+}
+
+static inline uint16_t highest16(vec a)
+{
+    a = max16(a, _mm_shuffle_epi32(a, 0x4E));
+    a = max16(a, _mm_shuffle_epi32(a, 0xB1));
+    a = max16(a, _mm_shufflelo_epi16(a, 0xB1));
+    return _mm_extract_epi16(a, 0);
+}
+
+#else
+
+// the same operations a lane at a time
+
+struct vec {
+    union {
+        uint8_t b[16];
+        uint16_t w[8];
+    };
+};
+
+template <typename F> static inline vec bytewise(vec a, vec b, F f)
+{
+    vec r;
+    for (size_t j = 0; j < 16; j++)
+        r.b[j] = f(a.b[j], b.b[j]);
+    return r;
+}
+
+template <typename F> static inline vec wordwise(vec a, vec b, F f)
+{
+    vec r;
+    for (size_t j = 0; j < 8; j++)
+        r.w[j] = f(a.w[j], b.w[j]);
+    return r;
+}
+
+static inline vec vload(const void *p)
+{
+    vec r;
+    memcpy(&r, p, sizeof(r));
+    return r;
+}
+
+static inline void vstore(void *p, vec a) { memcpy(p, &a, sizeof(a)); }
+
+static inline vec splat8(uint8_t a)
+{
+    vec r;
+    memset(r.b, a, sizeof(r.b));
+    return r;
+}
+
+static inline vec splat16(uint16_t a)
+{
+    vec r;
+    std::fill(r.w, r.w + 8, a);
+    return r;
+}
+
+static inline vec vand(vec a, vec b)
+{
+    return bytewise(a, b, [](uint8_t x, uint8_t y) { return x & y; });
+}
+
+static inline vec vandnot(vec a, vec b)
+{
+    return bytewise(a, b, [](uint8_t x, uint8_t y) { return ~x & y; });
+}
+
+static inline vec vor(vec a, vec b)
+{
+    return bytewise(a, b, [](uint8_t x, uint8_t y) { return x | y; });
+}
+
+static inline vec vxor(vec a, vec b)
+{
+    return bytewise(a, b, [](uint8_t x, uint8_t y) { return x ^ y; });
+}
+
+static inline vec add8(vec a, vec b)
+{
+    return bytewise(a, b, [](uint8_t x, uint8_t y) { return x + y; });
+}
+
+static inline vec sub8(vec a, vec b)
+{
+    return bytewise(a, b, [](uint8_t x, uint8_t y) { return x - y; });
+}
+
+static inline vec subs8(vec a, vec b)
+{
+    return bytewise(a, b, [](uint8_t x, uint8_t y) { return x > y ? x - y : 0; });
+}
+
+static inline vec max8(vec a, vec b)
+{
+    return bytewise(a, b, [](uint8_t x, uint8_t y) { return std::max(x, y); });
+}
+
+static inline vec eq8(vec a, vec b)
+{
+    return bytewise(a, b, [](uint8_t x, uint8_t y) { return x == y ? 0xFF : 0; });
+}
+
+template <int n> static inline vec shr8(vec a)
+{
+    return bytewise(a, a, [](uint8_t x, uint8_t) { return x >> n; });
+}
+
+static inline vec add16(vec a, vec b)
+{
+    return wordwise(a, b, [](uint16_t x, uint16_t y) { return x + y; });
+}
+
+static inline vec subs16(vec a, vec b)
+{
+    return wordwise(a, b,
+                    [](uint16_t x, uint16_t y) { return x > y ? x - y : 0; });
+}
+
+static inline vec eq16(vec a, vec b)
+{
+    return wordwise(a, b,
+                    [](uint16_t x, uint16_t y) { return x == y ? 0xFFFF : 0; });
+}
+
+static inline vec min16(vec a, vec b)
+{
+    return wordwise(a, b, [](uint16_t x, uint16_t y) {
+        return (int16_t)x < (int16_t)y ? x : y;
+    });
+}
+
+static inline vec widen(const uint8_t *p)
+{
+    vec r;
+    for (size_t j = 0; j < 8; j++)
+        r.w[j] = p[j];
+    return r;
+}
+
+static inline vec blend(vec mask, vec a, vec b)
+{
+    return vor(vand(mask, a), vandnot(mask, b));
+}
+
+static inline vec mask8(uint16_t bits)
+{
+    vec r;
+    for (size_t j = 0; j < 16; j++)
+        r.b[j] = bits >> j & 0x1 ? 0xFF : 0x0;
+    return r;
+}
+
+static inline uint16_t bits8(vec mask)
+{
+    uint16_t bits = 0;
+    for (size_t j = 0; j < 16; j++)
+        bits |= (mask.b[j] >> 7) << j;
+    return bits;
+}
+
+static inline vec mask16(uint8_t bits)
+{
+    vec r;
+    for (size_t j = 0; j < 8; j++)
+        r.w[j] = bits >> j & 0x1 ? 0xFFFF : 0x0;
+    return r;
+}
+
+static inline uint8_t bits16(vec mask)
+{
+    uint8_t bits = 0;
+    for (size_t j = 0; j < 8; j++)
+        bits |= (mask.w[j] >> 15) << j;
+    return bits;
+}
+
+static inline vec max16(vec a, vec b)
+{
+    return wordwise(a, b, [](uint16_t x, uint16_t y) {
+        return (int16_t)x > (int16_t)y ? x : y;
+    });
+}
+
+static inline uint16_t lowest16(vec a)
+{
+    int16_t low = a.w[0];
+    for (size_t j = 1; j < 8; j++)
+        low = std::min<int16_t>(low, a.w[j]);
+    return low;
+}
+
+static inline uint16_t highest16(vec a)
+{
+    int16_t high = a.w[0];
+    for (size_t j = 1; j < 8; j++)
+        high = std::max<int16_t>(high, a.w[j]);
+    return high;
+}
+
+#endif
+
+/**
+ * @brief call f(k, mask) for each run of 16 byte lanes from lane k that has
+ * lanes in group
+ */
+template <typename F> static inline void bytes_of(uint32_t group, F f)
+{
+    for (size_t k = 0; k < max_lanes; k += 16)
+        if (uint16_t bits = group >> k)
+            f(k, mask8(bits));
+}
+
+/**
+ * @brief the same for 8 word lanes at a time
+ */
+template <typename F> static inline void words_of(uint32_t group, F f)
+{
+    for (size_t k = 0; k < max_lanes; k += 8)
+        if (uint8_t bits = group >> k)
+            f(k, mask16(bits));
+}
+
+template <typename F> static inline void each_lane(uint32_t group, F f)
+{
+    for (; group; group &= group - 1)
+        f((size_t)std::countr_zero(group));
+}
+
+/**
+ * @brief the lanes of group where cond(k) holds for the 16 from lane k
+ */
+template <typename F> static inline uint32_t where(uint32_t group, F cond)
+{
+    uint32_t hits = 0;
+    bytes_of(group, [&](size_t k, vec mask) {
+        hits |= (uint32_t)bits8(vand(mask, cond(k))) << k;
+    });
+    return hits;
+}
+
+// write value to the lanes of mask in the row at p
+static inline void put(void *p, vec value, vec mask)
+{
+    vstore(p, blend(mask, value, vload(p)));
+}
+
+/**
+ * @brief write a byte to a lane's memory, a lane writing over the rom image
+ * or the two bytes after it stops sharing the image's decode
+ */
+static inline void poke(lockstep &m, size_t l, uint16_t addr, uint8_t value)
+{
+    addr &= 0xFFF;
+    m.lanes[l].mem[addr] = value;
+    if (addr < m.rom_end[l] + 0x2)
+        m.modified |= 1u << l;
+}
+
+static inline uint16_t opcode_at(const uint8_t *mem, uint16_t addr)
+{
+    return mem[addr & 0xFFF] << 8 | mem[(addr + 1) & 0xFFF];
+}
+
+/**
+ * @brief step the lanes in hit over the instruction at their pc, F000 NNNN
+ * is four bytes long
+ */
+static void skip(lockstep &m, uint32_t hit)
+{
+    if (!hit)
+        return;
+
+    uint16_t at = m.pc[std::countr_zero(hit)];
+    uint16_t len = opcode_at(m.image, at) == 0xF000 ? 0x4 : 0x2;
+
+    words_of(hit & ~m.modified, [&](size_t k, vec mask) {
+        put(m.pc + k, add16(vload(m.pc + k), splat16(len)), mask);
+    });
+
+    each_lane(hit & m.modified, [&](size_t l) {
+        m.pc[l] += opcode_at(m.lanes[l].mem, at) == 0xF000 ? 0x4 : 0x2;
+    });
+}
+
+static void exec_nop(lockstep &, const instr &, uint32_t) {}
+
+static void exec_cls(lockstep &m, const instr &, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        lane_state &s = m.lanes[l];
+        clear_planes(s.framebuffer, s.planes, s.dirty);
+    });
+}
+
+static void exec_ret(lockstep &m, const instr &, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        m.sp[l] -= 0x2;
+        const uint8_t *mem = m.lanes[l].mem;
+        m.pc[l] = mem[(m.sp[l] + 1) & 0xFFF] << 8 | mem[m.sp[l] & 0xFFF];
+    });
+}
+
+static void exec_jp(lockstep &m, const instr &d, uint32_t group)
+{
+    words_of(group, [&](size_t k, vec mask) {
+        put(m.pc + k, splat16(d.nnn), mask);
+    });
+}
+
+static void exec_call(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        poke(m, l, m.sp[l], m.pc[l] & 0xFF);
+        poke(m, l, m.sp[l] + 1, m.pc[l] >> 8);
+        m.sp[l] += 0x2;
+        m.pc[l] = d.nnn;
+    });
+}
+
+static void exec_se_imm(lockstep &m, const instr &d, uint32_t group)
+{
+    skip(m, where(group, [&](size_t k) {
+             return eq8(vload(m.v[d.x] + k), splat8(d.nn));
+         }));
+}
+
+static void exec_sne_imm(lockstep &m, const instr &d, uint32_t group)
+{
+    skip(m, group & ~where(group, [&](size_t k) {
+                return eq8(vload(m.v[d.x] + k), splat8(d.nn));
+            }));
+}
+
+static void exec_se_reg(lockstep &m, const instr &d, uint32_t group)
+{
+    skip(m, where(group, [&](size_t k) {
+             return eq8(vload(m.v[d.x] + k), vload(m.v[d.y] + k));
+         }));
+}
+
+static void exec_sne_reg(lockstep &m, const instr &d, uint32_t group)
+{
+    skip(m, group & ~where(group, [&](size_t k) {
+                return eq8(vload(m.v[d.x] + k), vload(m.v[d.y] + k));
+            }));
+}
+
+static void exec_ld_imm(lockstep &m, const instr &d, uint32_t group)
+{
+    bytes_of(group, [&](size_t k, vec mask) {
+        put(m.v[d.x] + k, splat8(d.nn), mask);
+    });
+}
+
+static void exec_add_imm(lockstep &m, const instr &d, uint32_t group)
+{
+    bytes_of(group, [&](size_t k, vec mask) {
+        put(m.v[d.x] + k, add8(vload(m.v[d.x] + k), splat8(d.nn)), mask);
+    });
+}
+
+static void exec_ld_reg(lockstep &m, const instr &d, uint32_t group)
+{
+    bytes_of(group, [&](size_t k, vec mask) {
+        put(m.v[d.x] + k, vload(m.v[d.y] + k), mask);
+    });
+}
+
+/**
+ * @brief 8XY1 / 8XY2 / 8XY3 through the matching vector op
+ */
+template <quirk_profile P, vec (*op)(vec, vec)>
+static void exec_logic(lockstep &m, const instr &d, uint32_t group)
+{
+    bytes_of(group, [&](size_t k, vec mask) {
+        put(m.v[d.x] + k, op(vload(m.v[d.x] + k), vload(m.v[d.y] + k)), mask);
+        if constexpr (quirk_sets[P].logic_vf)
+            put(m.v[0xF] + k, splat8(0x0), mask);
+    });
+}
+
+// vf is written before the result in all of the following, with x or y = F
+// they see the new vf exactly like the interpreter
+
+static void exec_add_reg(lockstep &m, const instr &d, uint32_t group)
+{
+    bytes_of(group, [&](size_t k, vec mask) {
+        vec a = vload(m.v[d.x] + k);
+        vec sum = add8(a, vload(m.v[d.y] + k));
+        // the sum wrapped if it came out below vx
+        put(m.v[0xF] + k, vandnot(eq8(max8(sum, a), sum), splat8(0x1)),
+            mask);
+        put(m.v[d.x] + k, add8(vload(m.v[d.x] + k), vload(m.v[d.y] + k)),
+            mask);
+    });
+}
+
+static void exec_sub(lockstep &m, const instr &d, uint32_t group)
+{
+    bytes_of(group, [&](size_t k, vec mask) {
+        vec a = vload(m.v[d.x] + k);
+        vec b = vload(m.v[d.y] + k);
+        put(m.v[0xF] + k, vandnot(eq8(max8(a, b), b), splat8(0x1)), mask);
+        put(m.v[d.x] + k, sub8(vload(m.v[d.x] + k), vload(m.v[d.y] + k)),
+            mask);
+    });
+}
+
+static void exec_subn(lockstep &m, const instr &d, uint32_t group)
+{
+    bytes_of(group, [&](size_t k, vec mask) {
+        vec a = vload(m.v[d.x] + k);
+        vec b = vload(m.v[d.y] + k);
+        put(m.v[0xF] + k, vandnot(eq8(max8(a, b), a), splat8(0x1)), mask);
+        put(m.v[d.x] + k, sub8(vload(m.v[d.y] + k), vload(m.v[d.x] + k)),
+            mask);
+    });
+}
+
+template <quirk_profile P>
+static void exec_shr(lockstep &m, const instr &d, uint32_t group)
+{
+    const uint8_t *src = m.v[quirk_sets[P].shift_vy ? d.y : d.x];
+    bytes_of(group, [&](size_t k, vec mask) {
+        put(m.v[0xF] + k, vand(vload(src + k), splat8(0x1)), mask);
+        put(m.v[d.x] + k, shr8<1>(vload(src + k)), mask);
+    });
+}
+
+template <quirk_profile P>
+static void exec_shl(lockstep &m, const instr &d, uint32_t group)
+{
+    const uint8_t *src = m.v[quirk_sets[P].shift_vy ? d.y : d.x];
+    bytes_of(group, [&](size_t k, vec mask) {
+        put(m.v[0xF] + k, shr8<7>(vload(src + k)), mask);
+        vec a = vload(src + k);
+        put(m.v[d.x] + k, add8(a, a), mask);
+    });
+}
+
+static void exec_ld_i(lockstep &m, const instr &d, uint32_t group)
+{
+    words_of(group, [&](size_t k, vec mask) {
+        put(m.i + k, splat16(d.nnn), mask);
+    });
+}
+
+template <quirk_profile P>
+static void exec_jp_v0(lockstep &m, const instr &d, uint32_t group)
+{
+    const uint8_t *base = m.v[quirk_sets[P].jump_vx ? d.x : 0x0];
+    words_of(group, [&](size_t k, vec mask) {
+        put(m.pc + k, add16(widen(base + k), splat16(d.nnn)), mask);
+    });
+}
+
+static void exec_rnd(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        m.v[d.x][l] = rng_next(m.rng[l]) & d.nn;
+    });
+}
+
+template <quirk_profile P>
+static void exec_drw(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        lane_state &s = m.lanes[l];
+        m.v[0xF][l] = draw_sprite<quirk_sets[P].edge>(
+            s.mem, s.dirty, s.framebuffer, s.planes, s.hires, m.i[l],
+            m.v[d.x][l], m.v[d.y][l], d.n);
+    });
+}
+
+// keys above F are never held
+static inline bool held(const lockstep &m, uint8_t key, size_t l)
+{
+    return key <= 0xF && m.keys[key] >> l & 0x1;
+}
+
+static void exec_skp(lockstep &m, const instr &d, uint32_t group)
+{
+    uint32_t hit = 0;
+    each_lane(group, [&](size_t l) { hit |= held(m, m.v[d.x][l], l) << l; });
+    skip(m, hit);
+}
+
+static void exec_sknp(lockstep &m, const instr &d, uint32_t group)
+{
+    uint32_t hit = 0;
+    each_lane(group, [&](size_t l) { hit |= !held(m, m.v[d.x][l], l) << l; });
+    skip(m, hit);
+}
+
+static void exec_ld_vx_dt(lockstep &m, const instr &d, uint32_t group)
+{
+    bytes_of(group, [&](size_t k, vec mask) {
+        put(m.v[d.x] + k, vload(m.delay + k), mask);
+    });
+}
+
+static void exec_ld_vx_k(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        for (uint8_t k = 0x0; k <= 0xF; k++)
+            if (held(m, k, l)) {
+                m.v[d.x][l] = k;
+                return;
+            }
+        m.pc[l] -= 0x2;
+    });
+}
+
+static void exec_ld_dt(lockstep &m, const instr &d, uint32_t group)
+{
+    bytes_of(group, [&](size_t k, vec mask) {
+        put(m.delay + k, vload(m.v[d.x] + k), mask);
+    });
+}
+
+static void exec_ld_st(lockstep &m, const instr &d, uint32_t group)
+{
+    bytes_of(group, [&](size_t k, vec mask) {
+        put(m.sound + k, vload(m.v[d.x] + k), mask);
+    });
+}
+
+static void exec_add_i(lockstep &m, const instr &d, uint32_t group)
+{
+    words_of(group, [&](size_t k, vec mask) {
+        put(m.i + k, add16(vload(m.i + k), widen(m.v[d.x] + k)), mask);
+    });
+}
+
+static void exec_ld_f(lockstep &m, const instr &d, uint32_t group)
+{
+    words_of(group, [&](size_t k, vec mask) {
+        vec x = widen(m.v[d.x] + k);
+        vec x4 = add16(add16(x, x), add16(x, x));
+        put(m.i + k, add16(add16(x4, x), splat16(font_addr)), mask);
+    });
+}
+
+static void exec_ld_b(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        uint8_t bcd = m.v[d.x][l];
+        poke(m, l, m.i[l] + 0x2, bcd % 10);
+        poke(m, l, m.i[l] + 0x1, bcd / 10 % 10);
+        poke(m, l, m.i[l] + 0x0, bcd / 100);
+    });
+}
+
+template <quirk_profile P>
+static void exec_ld_mem(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        for (size_t j = 0; j <= d.x; j++)
+            poke(m, l, m.i[l] + j, m.v[j][l]);
+        if constexpr (quirk_sets[P].load_i)
+            m.i[l] += d.x + 1;
+    });
+}
+
+template <quirk_profile P>
+static void exec_ld_regs(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        const uint8_t *mem = m.lanes[l].mem;
+        for (size_t j = 0; j <= d.x; j++)
+            m.v[j][l] = mem[(m.i[l] + j) & 0xFFF];
+        if constexpr (quirk_sets[P].load_i)
+            m.i[l] += d.x + 1;
+    });
+}
+
+/**
+ * @brief apply a scroll kernel to the selected planes of every lane in
+ * group, amounts are in pixels of the lane's resolution
+ */
+template <typename F>
+static void scroll(lockstep &m, uint32_t group, F kernel)
+{
+    each_lane(group, [&](size_t l) {
+        lane_state &s = m.lanes[l];
+        size_t h = s.hires ? display_h : display_h / 2;
+        for (size_t p = 0; p < display_planes; p++)
+            if (s.planes & (1 << p))
+                kernel(s.framebuffer[p], h, s.hires);
+        s.dirty = ~0ull;
+    });
+}
+
+static void exec_scd(lockstep &m, const instr &d, uint32_t group)
+{
+    scroll(m, group, [&](display_row *rows, size_t h, bool) {
+        scroll_down(rows, h, d.n);
+    });
+}
+
+static void exec_scu(lockstep &m, const instr &d, uint32_t group)
+{
+    scroll(m, group, [&](display_row *rows, size_t h, bool) {
+        scroll_up(rows, h, d.n);
+    });
+}
+
+static void exec_scr(lockstep &m, const instr &, uint32_t group)
+{
+    scroll(m, group, scroll_right);
+}
+
+static void exec_scl(lockstep &m, const instr &, uint32_t group)
+{
+    scroll(m, group, scroll_left);
+}
+
+static void exec_exit(lockstep &m, const instr &, uint32_t group)
+{
+    words_of(group, [&](size_t k, vec mask) {
+        put(m.pc + k, vload(m.rom_end + k), mask);
+    });
+}
+
+template <bool hires>
+static void exec_res(lockstep &m, const instr &, uint32_t group)
+{
+    // switching resolution clears every plane
+    each_lane(group, [&](size_t l) {
+        lane_state &s = m.lanes[l];
+        s.hires = hires;
+        memset(s.framebuffer, 0x0, sizeof(s.framebuffer));
+        s.dirty = ~0ull;
+    });
+}
+
+static void exec_save(lockstep &m, const instr &d, uint32_t group)
+{
+    size_t n = (d.x > d.y ? d.x - d.y : d.y - d.x) + 1;
+    int step = d.x > d.y ? -1 : 1;
+    each_lane(group, [&](size_t l) {
+        for (size_t j = 0; j < n; j++)
+            poke(m, l, m.i[l] + j, m.v[d.x + step * (int)j][l]);
+    });
+}
+
+static void exec_load(lockstep &m, const instr &d, uint32_t group)
+{
+    size_t n = (d.x > d.y ? d.x - d.y : d.y - d.x) + 1;
+    int step = d.x > d.y ? -1 : 1;
+    each_lane(group, [&](size_t l) {
+        const uint8_t *mem = m.lanes[l].mem;
+        for (size_t j = 0; j < n; j++)
+            m.v[d.x + step * (int)j][l] = mem[(m.i[l] + j) & 0xFFF];
+    });
+}
+
+static void exec_ld_i_long(lockstep &m, const instr &, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        m.i[l] = opcode_at(m.lanes[l].mem, m.pc[l]);
+        m.pc[l] += 0x2;
+    });
+}
+
+static void exec_plane(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) { m.lanes[l].planes = d.x & 0x3; });
+}
+
+static void exec_audio(lockstep &m, const instr &, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        lane_state &s = m.lanes[l];
+        for (size_t j = 0; j < 16; j++)
+            s.pattern[j] = s.mem[(m.i[l] + j) & 0xFFF];
+    });
+}
+
+static void exec_pitch(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) { m.lanes[l].pitch = m.v[d.x][l]; });
+}
+
+static void exec_ld_hf(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        m.i[l] = big_font_addr + (m.v[d.x][l] & 0xF) * 10;
+    });
+}
+
+static void exec_ld_r(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        for (size_t j = 0; j <= d.x; j++)
+            m.lanes[l].flags[j] = m.v[j][l];
+    });
+}
+
+static void exec_ld_vx_r(lockstep &m, const instr &d, uint32_t group)
+{
+    each_lane(group, [&](size_t l) {
+        for (size_t j = 0; j <= d.x; j++)
+            m.v[j][l] = m.lanes[l].flags[j];
+    });
+}
+
+/**
+ * @brief jump table indexed by instr::op, order matches the op enum, one
+ * instance per quirk profile, every slot of the cache is decoded up front
+ * so op_decode never comes up
+ */
+template <quirk_profile P>
+static const lane_handler handlers[op_count] = {
+    exec_nop,         exec_nop,         exec_cls,         exec_ret,
+    exec_jp,          exec_call,        exec_se_imm,      exec_sne_imm,
+    exec_se_reg,      exec_ld_imm,      exec_add_imm,     exec_ld_reg,
+    exec_logic<P, vor>, exec_logic<P, vand>, exec_logic<P, vxor>,
+    exec_add_reg,     exec_sub,         exec_shr<P>,      exec_subn,
+    exec_shl<P>,      exec_sne_reg,     exec_ld_i,        exec_jp_v0<P>,
+    exec_rnd,         exec_drw<P>,      exec_skp,         exec_sknp,
+    exec_ld_vx_dt,    exec_ld_vx_k,     exec_ld_dt,       exec_ld_st,
+    exec_add_i,       exec_ld_f,        exec_ld_b,        exec_ld_mem<P>,
+    exec_ld_regs<P>,  exec_scd,         exec_scu,         exec_scr,
+    exec_scl,         exec_exit,        exec_res<false>,  exec_res<true>,
+    exec_save,        exec_load,        exec_ld_i_long,   exec_plane,
+    exec_audio,       exec_pitch,       exec_ld_hf,       exec_ld_r,
+    exec_ld_vx_r,
+};
+
+static const lane_handler *const tables[quirks_count] = {
+    handlers<quirks_modern>,
+    handlers<quirks_vip>,
+    handlers<quirks_schip>,
+    handlers<quirks_xochip>,
+};
+
+lockstep::lockstep(size_t count, quirk_profile profile)
+    : lanes(std::clamp<size_t>(count, 1, max_lanes)), profile(profile)
+{
+    // every lane starts out as a machine with nothing loaded
+    load(nullptr, 0);
+}
+
+bool lockstep::load(const uint8_t *rom, size_t size)
+{
+    chip8 c;
+
+    if (size && !c.load(rom, size))
+        return false;
+
+    snapshot s;
+    ::capture(c, s);
+
+    memcpy(image, s.mem, sizeof(image));
+    for (size_t a = 0; a < 4096; a++)
+        cache[a] = decode(image[a] | image[(a + 1) & 0xFFF] << 8);
+
+    for (size_t l = 0; l < lanes.size(); l++)
+        restore(l, s);
+
+    return true;
+}
+
+void lockstep::press(size_t lane, uint8_t key, bool down)
+{
+    if (down)
+        keys[key & 0xF] |= 1u << lane;
+    else
+        keys[key & 0xF] &= ~(1u << lane);
+}
+
+void lockstep::run(size_t budget)
+{
+    // instructions left per lane are counted in 16 bit lanes
+    while (budget) {
+        uint16_t chunk = std::min<size_t>(budget, 0xFFFF);
+        run_chunk(chunk);
+        budget -= chunk;
+    }
+}
+
+void lockstep::run_chunk(uint16_t budget)
+{
+    const lane_handler *ops = tables[profile];
+
+    alignas(16) uint16_t left[max_lanes] = {};
+    std::fill(left, left + lanes.size(), budget);
+
+    // lanes past the count never run, skip the blocks of 8 they fill
+    size_t span = (lanes.size() + 7) & ~(size_t)7;
+
+    for (;;) {
+        // lanes with instructions left and pc below rom_end, and the lowest
+        // and highest pc among them, which are below 0x8000 and fit a
+        // signed compare
+        uint32_t live = 0;
+        vec lowest = splat16(0x7FFF);
+        vec highest = splat16(0x0);
+
+        for (size_t k = 0; k < span; k += 8) {
+            vec p = vload(pc + k);
+            vec stopped = vor(eq16(subs16(vload(rom_end + k), p), splat16(0)),
+                              eq16(vload(left + k), splat16(0)));
+            live |= (uint32_t)(uint8_t)~bits16(stopped) << k;
+            lowest = min16(lowest, blend(stopped, splat16(0x7FFF), p));
+            highest = max16(highest, vandnot(stopped, p));
+        }
+
+        if (!live)
+            break;
+
+        uint16_t at = lowest16(lowest);
+        uint32_t group = live;
+
+        // lanes that branched apart wait for the ones behind them
+        if (highest16(highest) != at) {
+            group = 0;
+            for (size_t k = 0; k < span; k += 8)
+                group |= (uint32_t)bits16(eq16(vload(pc + k), splat16(at)))
+                         << k;
+            group &= live;
+        }
+
+        // lanes still on the image share its decode, the others only join
+        // the group if they hold the same opcode
+        const instr *d = &cache[at];
+        instr own;
+
+        if (group & modified) {
+            uint16_t opcode = opcode_at(image, at);
+
+            if (!(group & ~modified)) {
+                opcode = opcode_at(lanes[std::countr_zero(group)].mem, at);
+                own = decode(opcode >> 8 | opcode << 8);
+                d = &own;
+            }
+
+            each_lane(group & modified, [&](size_t l) {
+                if (opcode_at(lanes[l].mem, at) != opcode)
+                    group &= ~(1u << l);
+            });
+        }
+
+        words_of(group, [&](size_t k, vec mask) {
+            put(pc + k, splat16(at + 0x2), mask);
+            put(left + k, add16(vload(left + k), splat16(0xFFFF)), mask);
+        });
+
+        ops[d->op](*this, *d, group);
+    }
+
+    for (size_t l = 0; l < lanes.size(); l++)
+        cycles[l] += budget - left[l];
+}
+
+void lockstep::tick()
+{
+    for (size_t k = 0; k < max_lanes; k += 16) {
+        vstore(delay + k, subs8(vload(delay + k), splat8(0x1)));
+        vstore(sound + k, subs8(vload(sound + k), splat8(0x1)));
+    }
+}
+
+void lockstep::capture(size_t lane, snapshot &s) const
+{
+    const lane_state &l = lanes[lane];
+
+    memset(&s, 0, sizeof(s));
+    memcpy(s.mem, l.mem, sizeof(s.mem));
+    memcpy(s.framebuffer, l.framebuffer, sizeof(s.framebuffer));
+    s.rng = rng[lane];
+    s.cycles = cycles[lane];
+    for (size_t j = 0; j < 16; j++) {
+        s.v[j] = v[j][lane];
+        s.keypad[j] = keys[j] >> lane & 0x1 ? 0xFF : 0x0;
+    }
+    memcpy(s.pattern, l.pattern, sizeof(s.pattern));
+    memcpy(s.flags, l.flags, sizeof(s.flags));
+    s.i = i[lane];
+    s.pc = pc[lane];
+    s.sp = sp[lane];
+    s.rom_end = rom_end[lane];
+    s.delay = delay[lane];
+    s.sound = sound[lane];
+    s.hires = l.hires;
+    s.planes = l.planes;
+    s.pitch = l.pitch;
+    s.profile = profile;
+}
+
+void lockstep::restore(size_t lane, const snapshot &s)
+{
+    lane_state &l = lanes[lane];
+
+    memcpy(l.mem, s.mem, sizeof(l.mem));
+    memcpy(l.framebuffer, s.framebuffer, sizeof(l.framebuffer));
+    rng[lane] = s.rng;
+    cycles[lane] = s.cycles;
+    for (size_t j = 0; j < 16; j++) {
+        v[j][lane] = s.v[j];
+        press(lane, j, s.keypad[j] == 0xFF);
+    }
+    memcpy(l.pattern, s.pattern, sizeof(l.pattern));
+    memcpy(l.flags, s.flags, sizeof(l.flags));
+    i[lane] = s.i;
+    pc[lane] = s.pc;
+    sp[lane] = s.sp;
+    rom_end[lane] = s.rom_end;
+    delay[lane] = s.delay;
+    sound[lane] = s.sound;
+    l.hires = s.hires;
+    l.planes = s.planes;
+    l.pitch = s.pitch;
+    l.dirty = ~0ull;
+
+    // code the image does not match has to be checked opcode by opcode
+    size_t code = std::min<size_t>(s.rom_end + 0x2, sizeof(image));
+    if (memcmp(l.mem, image, code) == 0)
+        modified &= ~(1u << lane);
+    else
+        modified |= 1u << lane;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "chip8.h"
+#include "state.h"
+
+// lanes one engine can hold, two 16 byte registers per chip-8 register
+#define max_lanes 32
+
+/**
+ * @brief memory, display and XO-CHIP extras of one lane, kept together
+ * since only the per-lane loops touch them
+ */
+struct lane_state {
+    uint8_t mem[4096];
+    display_row framebuffer[display_planes][display_h];
+    uint64_t dirty;
+    bool hires;
+    uint8_t planes;
+    uint8_t pattern[16];
+    uint8_t pitch;
+    uint8_t flags[16];
+};
+
+/**
+ * @brief up to max_lanes copies of one rom run side by side, for fuzzing
+ * and search workloads that try many seeds and inputs on the same code
+ *
+ * Registers are laid out lane by lane, v[x][lane], so one instruction runs
+ * for every lane at once. Each step takes the lowest pc among the running
+ * lanes and executes its instruction for all lanes at that pc with the same
+ * opcode while the rest wait, lanes that branched apart line up again at
+ * the next instruction they share. Register, timer and branch instructions
+ * are SSE2 over the whole group, memory, key and display instructions loop
+ * over its lanes.
+ *
+ * Every lane ends up exactly where a chip8 with the same rom, profile, seed
+ * and key presses would after the same run() and tick() calls.
+ */
+struct lockstep {
+    alignas(16) uint8_t v[16][max_lanes] = {};
+    alignas(16) uint16_t i[max_lanes] = {};
+    alignas(16) uint16_t pc[max_lanes] = {};
+    alignas(16) uint16_t sp[max_lanes] = {};
+    alignas(16) uint16_t rom_end[max_lanes] = {};
+    alignas(16) uint8_t delay[max_lanes] = {};
+    alignas(16) uint8_t sound[max_lanes] = {};
+
+    // bit l of keys[k] is key k held in lane l
+    uint32_t keys[16] = {};
+
+    uint64_t rng[max_lanes] = {};
+    uint64_t cycles[max_lanes] = {};
+
+    std::vector<lane_state> lanes;
+
+    // lanes that wrote to the rom image (or the byte after it) since it was
+    // loaded, only those have to have their opcodes checked
+    uint32_t modified = 0;
+
+    quirk_profile profile;
+
+    // the rom as loaded and its decode at every byte address
+    uint8_t image[4096] = {};
+    instr cache[4096];
+
+    explicit lockstep(size_t count, quirk_profile profile = quirks_modern);
+
+    /**
+     * @brief load a rom image into every lane, false if it overruns .text
+     */
+    bool load(const uint8_t *rom, size_t size);
+
+    void seed(size_t lane, uint64_t value) { rng[lane] = rng_seed(value); }
+
+    void press(size_t lane, uint8_t key, bool down);
+
+    bool halted(size_t lane) const { return pc[lane] >= rom_end[lane]; }
+
+    /**
+     * @brief run every lane for up to budget instructions, lanes stop early
+     * once halted
+     */
+    void run(size_t budget);
+
+    /**
+     * @brief count every lane's delay and sound timers down, call at 60 Hz
+     */
+    void tick();
+
+    /**
+     * @brief copy a lane to or from a snapshot, a restored lane keeps
+     * running under the engine's profile
+     */
+    void capture(size_t lane, snapshot &s) const;
+    void restore(size_t lane, const snapshot &s);
+
+private:
+    void run_chunk(uint16_t budget);
+};
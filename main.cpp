@@ -1,76 +1,212 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
 #include <format>
-#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <random>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <SDL3/SDL.h>
 
-#define entry_point 0x200
+#include "audio.h"
+#include "capture.h"
+#include "chip8.h"
+#include "input_log.h"
+#include "keymap.h"
+#include "state.h"
+#include "trace.h"
+#include "triple.h"
 
 /**
- * @brief memory layout
- * start   end   name
- * 0x200 - 0xE4F .text,
- * 0xE50 - 0xE9F .data,
- * 0xEA0 - 0xEFF .stack,
- * 0xF00 - 0xFFF .framebuffer (impossible)
+ * @brief a keypad transition waiting for the next frame, ns is the SDL
+ * event timestamp
  */
+struct key_press {
+    uint64_t ns;
+    uint8_t key;
+    bool down;
+};
 
-static uint8_t mem[4096];
-static uint16_t framebuffer[2048];
-
-static uint8_t v[16];
-static uint16_t i = 0x0;
-static uint16_t pc = entry_point;
-static uint16_t sp = 0xEA0;
-
-static uint8_t delay;
-static uint8_t sound;
-static uint8_t keypad[16];
-
-static uint8_t font[80] = {
-    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-    0x20, 0x60, 0x20, 0x20, 0x70, // 1
-    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-    0xF0, 0x80, 0xF0, 0x80, 0x80, // F
+/**
+ * @brief a finished frame handed from the cpu thread to the event loop,
+ * probe is the key down it is the first to show, 0 if none
+ */
+struct frame {
+    display_row rows[display_planes][display_h];
+    bool hires;
+    uint64_t probe;
 };
 
-static uint16_t fetch();
-static void exec(uint16_t opcode);
+/**
+ * @brief what the event loop hands the cpu thread, the keys plus requests
+ * it acts on at its next frame
+ */
+struct inbox {
+    std::mutex lock;
+    std::condition_variable wake;
+
+    std::vector<key_press> keys;
+    bool save = false;
+    bool load = false;
+    bool dump = false;
+    bool rewinding = false;
+    bool quit = false;
+
+    /**
+     * @brief anything a cpu waiting on FX0A has to wake up for
+     */
+    bool pending() const { return !keys.empty() || save || load || quit; }
+
+    template <typename F> void post(F change)
+    {
+        {
+            std::lock_guard<std::mutex> hold(lock);
+            change(*this);
+        }
+        wake.notify_one();
+    }
+};
 
-#ifndef NDEBUG
-static std::string disassemble(uint16_t opcode);
-#endif
+static void upload(SDL_Texture *texture, const frame &f, uint64_t rows);
+static void report(std::vector<uint64_t> &latencies);
+static void feed(void *userdata, SDL_AudioStream *stream, int additional,
+                 int total);
 
 int main(int argc, char *argv[])
 {
     if (argc < 2) {
-        std::cerr << "Usage: <filepath>" << std::endl;
+        std::cerr << "Usage: <filepath> [--ipf <n>] [--unthrottled] [--jit] "
+                     "[--seed <n>]\n"
+                     "       [--record <log>] [--replay <log>] "
+                     "[--trace <path>]\n"
+                     "       [--keymap <path>] [--latency] "
+                     "[--quirks <profile>]\n"
+                     "       [--capture <y4m|->] [--capture-raw <path>]"
+                  << std::endl;
+        return 1;
+    }
+
+    // instructions per 60 Hz frame, 0 runs the cpu flat out until the next
+    // frame deadline
+    size_t ipf = default_ipf;
+    bool unthrottled = false;
+    bool jit = false;
+    uint64_t seed = std::random_device()();
+    const char *record_path = nullptr;
+    const char *replay_path = nullptr;
+    const char *trace_path = nullptr;
+    const char *capture_path = nullptr;
+    capture_format format = capture_y4m;
+    keymap keys;
+    bool latency = false;
+    quirk_profile profile = quirks_modern;
+
+    for (int arg = 2; arg < argc; arg++) {
+        std::string opt = argv[arg];
+        if (opt == "--ipf" && arg + 1 < argc)
+            ipf = std::stoul(argv[++arg]);
+        else if (opt == "--unthrottled")
+            unthrottled = true;
+        else if (opt == "--jit")
+            jit = true;
+        else if (opt == "--seed" && arg + 1 < argc)
+            seed = std::stoull(argv[++arg]);
+        else if (opt == "--record" && arg + 1 < argc)
+            record_path = argv[++arg];
+        else if (opt == "--replay" && arg + 1 < argc)
+            replay_path = argv[++arg];
+        else if (opt == "--trace" && arg + 1 < argc)
+            trace_path = argv[++arg];
+        else if (opt == "--capture" && arg + 1 < argc) {
+            capture_path = argv[++arg];
+            format = capture_y4m;
+        } else if (opt == "--capture-raw" && arg + 1 < argc) {
+            capture_path = argv[++arg];
+            format = capture_raw;
+        } else if (opt == "--keymap" && arg + 1 < argc) {
+            if (!keys.load(argv[++arg])) {
+                std::cerr << "Error: invalid keymap" << std::endl;
+                return 1;
+            }
+        } else if (opt == "--latency")
+            latency = true;
+        else if (opt == "--quirks" && arg + 1 < argc) {
+            if (!find_profile(argv[++arg], profile)) {
+                std::cerr << "Error: unknown quirk profile " << argv[arg]
+                          << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Error: unknown option " << opt << std::endl;
+            return 1;
+        }
+    }
+
+    // a replay runs the recorded ipf, unthrottled it skips frame pacing
+    input_replay replay;
+
+    if (replay_path) {
+        if (!replay.open(replay_path)) {
+            std::cerr << "Error: invalid input log" << std::endl;
+            return 1;
+        }
+        seed = replay.seed;
+        ipf = replay.ipf;
+        profile = replay.profile;
+    } else if (unthrottled)
+        ipf = 0;
+
+    // timers tick every ipf cycles, replays need that to be fixed
+    input_recorder recorder;
+
+    if (record_path) {
+        if (ipf == 0 || replay_path) {
+            std::cerr << "Error: --record needs a fixed --ipf and no --replay"
+                      << std::endl;
+            return 1;
+        }
+        if (!recorder.open(record_path, seed, ipf, profile)) {
+            std::cerr << "Error: cannot write input log" << std::endl;
+            return 1;
+        }
+    }
+
+    tracer trace;
+
+    if (trace_path && !trace.open(trace_path)) {
+        std::cerr << "Error: cannot write trace" << std::endl;
+        return 1;
+    }
+
+    frame_capture capture;
+
+    if (capture_path && !capture.open(capture_path, format)) {
+        std::cerr << "Error: cannot write capture" << std::endl;
         return 1;
     }
 
-    std::ifstream f(argv[1], std::ios::binary | std::ios::ate);
+    chip8 machine;
 
-    if (!f.is_open()) {
+    if (!machine.load(argv[1])) {
         std::cerr << "Error: invalid file" << std::endl;
         return 1;
     }
 
-    size_t filesize = f.tellg();
-    f.seekg(0);
+    machine.seed(seed);
+    machine.set_profile(profile);
+
+    if (jit && !machine.use_jit(true))
+        std::cerr << "Warning: jit unavailable, interpreting" << std::endl;
+
+    if (trace_path)
+        machine.trace = &trace;
 
     if (!SDL_Init(SDL_INIT_VIDEO)) {
         std::cerr << "SDL_Init Failed: " << SDL_GetError() << std::endl;
@@ -91,120 +227,297 @@ int main(int argc, char *argv[])
     }
 
     texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA4444,
-                                SDL_TEXTUREACCESS_STREAMING, 64, 32);
+                                SDL_TEXTUREACCESS_STREAMING, display_w,
+                                display_h);
 
     SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
 
-    uint16_t opcode;
-    size_t offset = 0;
+    // presenting can block on vsync now that it no longer holds up the cpu
+    SDL_SetRenderVSync(renderer, 1);
+
+    // the device pulls samples on its own thread, the emulation only ever
+    // appends to the ring
+    beeper beep;
+    SDL_AudioStream *audio = nullptr;
+    SDL_AudioSpec spec = {SDL_AUDIO_F32, 1, audio_rate};
+
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO))
+        audio = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK,
+                                          &spec, feed, &beep);
+
+    if (audio)
+        SDL_ResumeAudioStreamDevice(audio);
+    else
+        std::cerr << "Warning: no audio, " << SDL_GetError() << std::endl;
+
+    // F5 saves next to the rom, F9 loads, backspace held rewinds
+    std::string state_path = std::string(argv[1]) + ".state";
+    rewind_buffer history;
+
+    // -DCHIP8_PROFILE builds dump counters on F12 and on exit
+    [[maybe_unused]] std::string profile_path =
+        std::string(argv[1]) + ".profile.json";
+    profiled(std::atomic<uint64_t> render_ns{0};)
+
+    // the cpu thread owns the machine, this thread owns the window and
+    // only ever sees finished frames
+    inbox in;
+    triple_buffer<frame> frames;
+    std::atomic<bool> notified{false};
+    std::atomic<bool> finished{false};
+
+    SDL_Event wakeup = {};
+    wakeup.type = SDL_RegisterEvents(1);
+
+    std::thread cpu([&] {
+        // keys as of the last frame, and the transitions seen since,
+        // stamped with the host time they happened at
+        uint8_t keypad[16] = {};
+        std::vector<key_press> pending;
+        uint64_t last_run = SDL_GetTicksNS();
+        uint64_t deadline = last_run + frame_ns;
+        bool rewinding = false;
+
+        // --latency measures from a key down to the first present with new
+        // pixels after the machine saw it
+        uint64_t probe = 0;
+
+        auto apply = [&](const key_press &p) {
+            keypad[p.key] = p.down ? 0xFF : 0x0;
+            recorder.press(machine, p.key, p.down);
+            if (latency && p.down && !probe)
+                probe = p.ns;
+        };
+
+        while (!machine.halted()) {
+            bool save, load, dump;
+
+            {
+                std::unique_lock<std::mutex> hold(in.lock);
+
+                // a rom blocked on FX0A cannot change before a key does,
+                // sleep until one arrives or the frame is due
+                uint64_t now = SDL_GetTicksNS();
+                if (machine.idle == idle_key && !replay_path && now < deadline)
+                    in.wake.wait_for(hold,
+                                     std::chrono::nanoseconds(deadline - now),
+                                     [&] { return in.pending(); });
+
+                if (in.quit)
+                    break;
+
+                pending.swap(in.keys);
+                save = std::exchange(in.save, false);
+                load = std::exchange(in.load, false);
+                dump = std::exchange(in.dump, false);
+                rewinding = in.rewinding;
+            }
 
-    // set up font in memory
-    memcpy(mem + 0xE50, font, 80);
+            if (save && !save_state(machine, state_path.c_str()))
+                std::cerr << "Error: cannot save " << state_path << std::endl;
 
-    while (!f.eof()) {
-        f.read((char *)&opcode, 2);
-        memcpy(mem + entry_point + offset, &opcode, 2);
-        offset += 2;
-    }
+            if (load && !load_state(machine, state_path.c_str()))
+                std::cerr << "Error: cannot load " << state_path << std::endl;
+
+            if (dump) {
+                profiled(machine.prof.render_ns = render_ns;
+                         machine.prof.dump(profile_path.c_str());)
+            }
+
+            // replays bring their own keys, otherwise put back whatever a
+            // rewind or F9 changed under the held keys
+            if (replay_path)
+                pending.clear();
+            else
+                for (uint8_t k = 0x0; k <= 0xF; k++)
+                    if (keypad[k] != machine.keypad[k])
+                        recorder.press(machine, k, keypad[k]);
+
+            uint64_t now = SDL_GetTicksNS();
+
+            if (rewinding) {
+                history.pop(machine);
+                for (const key_press &p : pending)
+                    keypad[p.key] = p.down ? 0xFF : 0x0;
+            } else {
+                profiled(profile_timer timer{machine.prof.cpu_ns};)
+                [[maybe_unused]] size_t executed = 0;
+
+                if (replay_path)
+                    executed = replay.run(machine, ipf);
+                else if (ipf) {
+                    // a key that came in a third of the way through the
+                    // last frame lands a third of the way through this one
+                    for (const key_press &p : pending) {
+                        size_t at = 0;
+                        if (p.ns > last_run && now > last_run)
+                            at = std::min((p.ns - last_run) * ipf /
+                                              (now - last_run),
+                                          (uint64_t)ipf - 1);
+
+                        if (at > executed)
+                            executed += machine.run(at - executed);
+                        apply(p);
+                    }
+
+                    executed += machine.run(ipf - executed);
+                } else {
+                    for (const key_press &p : pending)
+                        apply(p);
+
+                    // check the clock every few hundred instructions only,
+                    // an idle rom has nothing left to do before the next
+                    // tick
+                    while (!machine.halted() &&
+                           SDL_GetTicksNS() < deadline) {
+                        executed += machine.run(256);
+                        if (machine.idle)
+                            break;
+                    }
+                }
+
+                profiled(machine.prof.frame(executed);)
+
+                if (audio)
+                    beep.frame(machine);
+
+                // timers count down at 60 Hz regardless of the instruction
+                // rate
+                machine.tick();
+                history.push(machine);
+            }
+
+            pending.clear();
+            last_run = now;
+
+            capture.frame(machine);
+
+            // nothing drawn this frame, the last present is still correct
+            if (machine.dirty) {
+                frame &f = frames.write();
+                memcpy(f.rows, machine.framebuffer, sizeof(f.rows));
+                f.hires = machine.hires;
+                f.probe = probe;
+                frames.publish();
+
+                machine.dirty = 0x0;
+                probe = 0;
+
+                // one wakeup until the event loop has taken the frame
+                if (!notified.exchange(true))
+                    SDL_PushEvent(&wakeup);
+            }
+
+            now = SDL_GetTicksNS();
+            if (replay_path && unthrottled)
+                deadline = now;
+            else if (now < deadline) {
+                if (machine.idle != idle_key || replay_path)
+                    SDL_DelayPrecise(deadline - now);
+            } else if (now - deadline > 4 * frame_ns)
+                deadline = now; // too far behind to catch up, drop the
+                                // backlog
+            deadline += frame_ns;
+        }
+
+        finished = true;
+        SDL_PushEvent(&wakeup);
+    });
+
+    // frame the texture holds, diffed against each new frame so frames the
+    // cpu published in between cannot leave stale rows behind
+    frame shown = {};
+    std::vector<uint64_t> latencies;
+    bool redraw = true;
 
     SDL_Event event;
-    bool running = true;
 
-    while (pc < (entry_point + filesize) && running) {
-        while (SDL_PollEvent(&event)) {
+    while (!finished) {
+        if (!SDL_WaitEvent(&event))
+            continue;
+
+        do {
             if (event.type == SDL_EVENT_QUIT)
-                running = false;
-            if (event.type == SDL_EVENT_KEY_DOWN) {
+                in.post([](inbox &i) { i.quit = true; });
+            else if (event.type == SDL_EVENT_WINDOW_EXPOSED)
+                redraw = true;
+            else if (event.type == SDL_EVENT_KEY_DOWN) {
                 if (event.key.key == SDLK_ESCAPE)
-                    running = false;
-                else if (event.key.key == SDLK_1)
-                    keypad[0x1] = 0xFF;
-                else if (event.key.key == SDLK_2)
-                    keypad[0x2] = 0xFF;
-                else if (event.key.key == SDLK_3)
-                    keypad[0x3] = 0xFF;
-                else if (event.key.key == SDLK_4)
-                    keypad[0xC] = 0xFF;
-                else if (event.key.key == SDLK_Q)
-                    keypad[0x4] = 0xFF;
-                else if (event.key.key == SDLK_W)
-                    keypad[0x5] = 0xFF;
-                else if (event.key.key == SDLK_E)
-                    keypad[0x6] = 0xFF;
-                else if (event.key.key == SDLK_R)
-                    keypad[0xD] = 0xFF;
-                else if (event.key.key == SDLK_A)
-                    keypad[0x7] = 0xFF;
-                else if (event.key.key == SDLK_S)
-                    keypad[0x8] = 0xFF;
-                else if (event.key.key == SDLK_D)
-                    keypad[0x9] = 0xFF;
-                else if (event.key.key == SDLK_F)
-                    keypad[0xE] = 0xFF;
-                else if (event.key.key == SDLK_Z)
-                    keypad[0xA] = 0xFF;
-                else if (event.key.key == SDLK_X)
-                    keypad[0x0] = 0xFF;
-                else if (event.key.key == SDLK_C)
-                    keypad[0xB] = 0xFF;
-                else if (event.key.key == SDLK_V)
-                    keypad[0xF] = 0xFF;
+                    in.post([](inbox &i) { i.quit = true; });
+                else if (event.key.key == SDLK_F5)
+                    in.post([](inbox &i) { i.save = true; });
+                else if (event.key.key == SDLK_F9) {
+                    if (record_path || replay_path)
+                        std::cerr << "Error: cannot load while recording "
+                                     "or replaying"
+                                  << std::endl;
+                    else
+                        in.post([](inbox &i) { i.load = true; });
+                } else if (event.key.key == SDLK_BACKSPACE) {
+                    if (!record_path && !replay_path)
+                        in.post([](inbox &i) { i.rewinding = true; });
+                } else if (event.key.key == SDLK_F12)
+                    in.post([](inbox &i) { i.dump = true; });
+                else if (!event.key.repeat && keys[event.key.scancode] !=
+                                                  key_none) {
+                    key_press p = {event.key.timestamp,
+                                   keys[event.key.scancode], true};
+                    in.post([&](inbox &i) { i.keys.push_back(p); });
+                }
             } else if (event.type == SDL_EVENT_KEY_UP) {
-                if (event.key.key == SDLK_1)
-                    keypad[0x1] = 0x0;
-                else if (event.key.key == SDLK_2)
-                    keypad[0x2] = 0x0;
-                else if (event.key.key == SDLK_3)
-                    keypad[0x3] = 0x0;
-                else if (event.key.key == SDLK_4)
-                    keypad[0xC] = 0x0;
-                else if (event.key.key == SDLK_Q)
-                    keypad[0x4] = 0x0;
-                else if (event.key.key == SDLK_W)
-                    keypad[0x5] = 0x0;
-                else if (event.key.key == SDLK_E)
-                    keypad[0x6] = 0x0;
-                else if (event.key.key == SDLK_R)
-                    keypad[0xD] = 0x0;
-                else if (event.key.key == SDLK_A)
-                    keypad[0x7] = 0x0;
-                else if (event.key.key == SDLK_S)
-                    keypad[0x8] = 0x0;
-                else if (event.key.key == SDLK_D)
-                    keypad[0x9] = 0x0;
-                else if (event.key.key == SDLK_F)
-                    keypad[0xE] = 0x0;
-                else if (event.key.key == SDLK_Z)
-                    keypad[0xA] = 0x0;
-                else if (event.key.key == SDLK_X)
-                    keypad[0x0] = 0x0;
-                else if (event.key.key == SDLK_C)
-                    keypad[0xB] = 0x0;
-                else if (event.key.key == SDLK_V)
-                    keypad[0xF] = 0x0;
+                if (event.key.key == SDLK_BACKSPACE)
+                    in.post([](inbox &i) { i.rewinding = false; });
+                else if (keys[event.key.scancode] != key_none) {
+                    key_press p = {event.key.timestamp,
+                                   keys[event.key.scancode], false};
+                    in.post([&](inbox &i) { i.keys.push_back(p); });
+                }
             }
-        }
+        } while (SDL_PollEvent(&event));
 
-        if (delay > 0)
-            delay--;
+        // clear first, a frame published after this wakes us again
+        notified = false;
+        bool fresh = frames.acquire();
 
-        if (sound > 0)
-            sound--;
+        if (!fresh && !redraw)
+            continue;
 
-        opcode = fetch();
-#ifndef NDEBUG
-        std::cout << std::hex << pc - 0x2 << " " << disassemble(opcode)
-                  << std::endl;
-#endif
-        exec(opcode);
-        SDL_UpdateTexture(texture, NULL, framebuffer, 32 * 4);
-        SDL_RenderClear(renderer);
-        SDL_RenderTexture(renderer, texture, nullptr, nullptr);
-        SDL_RenderPresent(renderer);
-        SDL_Delay(1);
+        profiled(uint64_t ns = 0;)
+        {
+            profiled(profile_timer timer{ns};)
+
+            const frame &f = frames.read();
+            uint64_t dirty = redraw || f.hires != shown.hires ? ~0ull : 0x0;
+
+            for (int p = 0; p < display_planes; p++)
+                for (int y = 0; y < display_h; y++)
+                    if (memcmp(f.rows[p][y], shown.rows[p][y],
+                               sizeof(display_row)))
+                        dirty |= 1ull << y;
+
+            upload(texture, f, dirty);
+            shown = f;
+            redraw = false;
+
+            SDL_RenderClear(renderer);
+            SDL_RenderTexture(renderer, texture, nullptr, nullptr);
+            SDL_RenderPresent(renderer);
+
+            if (fresh && f.probe)
+                latencies.push_back(SDL_GetTicksNS() - f.probe);
+        }
+        profiled(render_ns += ns;)
     }
 
-    f.close();
+    cpu.join();
+
+    profiled(machine.prof.render_ns = render_ns;
+             machine.prof.dump(profile_path.c_str());)
+
+    if (latency)
+        report(latencies);
+
+    SDL_DestroyAudioStream(audio);
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -213,372 +526,78 @@ int main(int argc, char *argv[])
     return 0;
 }
 
-uint16_t fetch()
-{
-    uint16_t opcode = *(uint16_t *)&mem[pc];
-    pc += 0x2;
-    return opcode;
-}
-
-void exec(uint16_t opcode)
+/**
+ * @brief unpack the dirty rows of the planes into RGBA4444 texels, lores
+ * pixels are doubled to fill the 128x64 texture, one texture update per run
+ * of adjacent rows
+ */
+void upload(SDL_Texture *texture, const frame &f, uint64_t rows)
 {
-    opcode = (opcode >> 8) | (opcode << 8); // little-endian to big-endian
-
-    uint8_t nibble = (opcode >> 12);
-
-    if (opcode == 0xEE) {
-        pc = mem[--sp] << 8;
-        pc |= mem[--sp];
-    } else if (opcode == 0xE0)
-        memset(framebuffer, 0x0, 2048 * 2);
-    else if (nibble == 0x0) {
-        // return std::format("0NNN");
-    }
-
-    if (nibble == 0x1)
-        pc = (opcode & 0xFFF);
-    else if (nibble == 0x2) {
-        mem[sp++] = pc & 0xFF;
-        mem[sp++] = (pc & 0xFF00) >> 8;
-        pc = (opcode & 0xFFF);
-    } else if (nibble == 0xa)
-        i = (opcode & 0xFFF);
-    else if (nibble == 0xb)
-        pc = v[0x0] + (opcode & 0xFFF);
-
-    if (nibble == 0x6)
-        v[(opcode & 0xF00) >> 8] = (opcode & 0xFF);
-    else if (nibble == 0x7)
-        v[(opcode & 0xF00) >> 8] += (opcode & 0xFF);
-    else if (nibble == 0xc)
-        v[(opcode & 0xF00) >> 8] = (rand() % 256) & (opcode & 0xFF);
-
-    if (nibble == 0x8) {
-        if ((opcode & 0xF) == 0x0)
-            v[(opcode & 0xF00) >> 8] = v[(opcode & 0xF0) >> 4];
-        else if ((opcode & 0xF) == 0x1)
-            v[(opcode & 0xF00) >> 8] =
-                v[(opcode & 0xF00) >> 8] | v[(opcode & 0xF0) >> 4];
-        else if ((opcode & 0xF) == 0x2)
-            v[(opcode & 0xF00) >> 8] =
-                v[(opcode & 0xF00) >> 8] & v[(opcode & 0xF0) >> 4];
-        else if ((opcode & 0xF) == 0x3)
-            v[(opcode & 0xF00) >> 8] =
-                v[(opcode & 0xF00) >> 8] ^ v[(opcode & 0xF0) >> 4];
-        else if ((opcode & 0xF) == 0x4) {
-            if ((v[(opcode & 0xF00) >> 8] + v[(opcode & 0xF0) >> 4]) > 0xFF)
-                v[0xF] = 0x1;
-            else
-                v[0xF] = 0x0;
-            v[(opcode & 0xF00) >> 8] += v[(opcode & 0xF0) >> 4];
-        } else if ((opcode & 0xF) == 0x5) {
-            if (v[(opcode & 0xF00) >> 8] > v[(opcode & 0xF0) >> 4])
-                v[0xF] = 0x1;
-            else
-                v[0xF] = 0x0;
-            v[(opcode & 0xF00) >> 8] -= v[(opcode & 0xF0) >> 4];
-        } else if ((opcode & 0xF) == 0x6) {
-            v[0xF] = v[(opcode & 0xF00) >> 8] & 0x1;
-            v[(opcode & 0xF00) >> 8] >>= 1;
-        } else if ((opcode & 0xF) == 0x7) {
-            if (v[(opcode & 0xF00) >> 8] < v[(opcode & 0xF0) >> 4])
-                v[0xF] = 0x1;
-            else
-                v[0xF] = 0x0;
-            v[(opcode & 0xF00) >> 8] =
-                v[(opcode & 0xF0) >> 4] - v[(opcode & 0xF00) >> 8];
-        } else if ((opcode & 0xF) == 0xE) {
-            v[0xF] = (v[(opcode & 0xF00) >> 8] & 0x80) >> 7;
-            v[(opcode & 0xF00) >> 8] <<= 1;
-        }
-    }
-
-    if (nibble == 0xe) {
-        if ((opcode & 0xFF) == 0x9e) {
-            if (keypad[v[(opcode & 0xF00) >> 8]] == 0xFF)
-                pc += 0x2;
-        } else if ((opcode & 0xFF) == 0xa1) {
-            if (keypad[v[(opcode & 0xF00) >> 8]] != 0xFF)
-                pc += 0x2;
+    uint16_t pixels[display_w * display_h];
+    int scale = f.hires ? 1 : 2;
+    int h = display_h / scale;
+
+    for (int y = 0; y < h;) {
+        if (!(rows & (1ull << y))) {
+            y++;
+            continue;
         }
-    }
 
-    if (nibble == 0xf) {
-        if ((opcode & 0xF) == 0xa) {
-            if (keypad[0x0] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0x0;
-            else if (keypad[0x1] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0x1;
-            else if (keypad[0x2] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0x2;
-            else if (keypad[0x3] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0x3;
-            else if (keypad[0x4] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0x4;
-            else if (keypad[0x5] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0x5;
-            else if (keypad[0x6] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0x6;
-            else if (keypad[0x7] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0x7;
-            else if (keypad[0x8] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0x8;
-            else if (keypad[0x9] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0x9;
-            else if (keypad[0xA] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0xA;
-            else if (keypad[0xB] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0xB;
-            else if (keypad[0xC] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0xC;
-            else if (keypad[0xD] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0xD;
-            else if (keypad[0xE] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0xE;
-            else if (keypad[0xF] == 0xFF)
-                v[(opcode & 0xF00) >> 8] = 0xF;
-            else
-                pc -= 0x2;
-        } else if ((opcode & 0xFF) == 0x1e)
-            i += v[(opcode & 0xF00) >> 8];
-        else if ((opcode & 0xFF) == 0x7)
-            v[(opcode & 0xF00) >> 8] = delay;
-        else if ((opcode & 0xFF) == 0x15)
-            delay = v[(opcode & 0xF00) >> 8];
-        else if ((opcode & 0xFF) == 0x18)
-            sound = v[(opcode & 0xF00) >> 8];
-        else if ((opcode & 0xFF) == 0x29)
-            i = 0xE50 + v[(opcode & 0xF00) >> 8] * 5;
-        else if ((opcode & 0xFF) == 0x33) {
-            uint8_t bcd = v[(opcode & 0xF00) >> 8];
-            mem[i + 0x2] = bcd % 10;
-            bcd /= 10;
-            mem[i + 0x1] = bcd % 10;
-            bcd /= 10;
-            mem[i + 0x0] = bcd % 10;
-        } else if ((opcode & 0xFF) == 0x55) {
-            for (size_t j = 0; j <= ((opcode & 0xF00) >> 8); j++)
-                mem[i + j] = v[j];
-        } else if ((opcode & 0xFF) == 0x65) {
-            for (size_t j = 0; j <= ((opcode & 0xF00) >> 8); j++)
-                v[j] = mem[i + j];
-        }
-    }
-
-    if (nibble == 0x3) {
-        if (v[(opcode & 0xF00) >> 8] == (opcode & 0xFF))
-            pc += 0x2;
-    } else if (nibble == 0x4) {
-        if (v[(opcode & 0xF00) >> 8] != (opcode & 0xFF))
-            pc += 0x2;
-    } else if (nibble == 0x5) {
-        if (v[(opcode & 0xF00) >> 8] == v[(opcode & 0xF0) >> 4])
-            pc += 0x2;
-    } else if (nibble == 0x9) {
-        if (v[(opcode & 0xF00) >> 8] != v[(opcode & 0xF0) >> 4])
-            pc += 0x2;
-    }
-
-    if (nibble == 0xd) {
-        size_t offset = 0;
-        v[0xF] = 0x0;
-        for (size_t j = 0; j < (opcode & 0xF); j++) {
-            if (mem[i + offset] & 0x80) {
-                if (framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                                 v[(opcode & 0xF00) >> 8] + 0) %
-                                2048] &
-                    0xBD8D)
-                    v[0xF] = 0x1;
-                framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                             v[(opcode & 0xF00) >> 8] + 0) %
-                            2048] ^= 0xBD8D;
-            }
-            if (mem[i + offset] & 0x40) {
-                if (framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                                 v[(opcode & 0xF00) >> 8] + 1) %
-                                2048] &
-                    0xBD8D)
-                    v[0xF] = 0x1;
-                framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                             v[(opcode & 0xF00) >> 8] + 1) %
-                            2048] ^= 0xBD8D;
-            }
-            if (mem[i + offset] & 0x20) {
-                if (framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                                 v[(opcode & 0xF00) >> 8] + 2) %
-                                2048] &
-                    0xBD8D)
-                    v[0xF] = 0x1;
-                framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                             v[(opcode & 0xF00) >> 8] + 2) %
-                            2048] ^= 0xBD8D;
-            }
-            if (mem[i + offset] & 0x10) {
-                if (framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                                 v[(opcode & 0xF00) >> 8] + 3) %
-                                2048] &
-                    0xBD8D)
-                    v[0xF] = 0x1;
-                framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                             v[(opcode & 0xF00) >> 8] + 3) %
-                            2048] ^= 0xBD8D;
-            }
-            if (mem[i + offset] & 0x08) {
-                if (framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                                 v[(opcode & 0xF00) >> 8] + 4) %
-                                2048] &
-                    0xBD8D)
-                    v[0xF] = 0x1;
-                framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                             v[(opcode & 0xF00) >> 8] + 4) %
-                            2048] ^= 0xBD8D;
-            }
-            if (mem[i + offset] & 0x04) {
-                if (framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                                 v[(opcode & 0xF00) >> 8] + 5) %
-                                2048] &
-                    0xBD8D)
-                    v[0xF] = 0x1;
-                framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                             v[(opcode & 0xF00) >> 8] + 5) %
-                            2048] ^= 0xBD8D;
-            }
-            if (mem[i + offset] & 0x02) {
-                if (framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                                 v[(opcode & 0xF00) >> 8] + 6) %
-                                2048] &
-                    0xBD8D)
-                    v[0xF] = 0x1;
-                framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                             v[(opcode & 0xF00) >> 8] + 6) %
-                            2048] ^= 0xBD8D;
+        int first = y;
+        for (; y < h && (rows & (1ull << y)); y++)
+            for (int x = 0; x < display_w / scale; x++) {
+                int bit = 63 - (x & 63);
+                int index = (f.rows[0][y][x >> 6] >> bit & 0x1) |
+                            (f.rows[1][y][x >> 6] >> bit & 0x1) << 1;
+
+                for (int j = 0; j < scale; j++)
+                    for (int k = 0; k < scale; k++)
+                        pixels[(y * scale + j) * display_w + x * scale + k] =
+                            palette[index];
             }
-            if (mem[i + offset] & 0x01) {
-                if (framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                                 v[(opcode & 0xF00) >> 8] + 7) %
-                                2048] &
-                    0xBD8D)
-                    v[0xF] = 0x1;
-                framebuffer[((v[(opcode & 0xF0) >> 4] + j) * 64 +
-                             v[(opcode & 0xF00) >> 8] + 7) %
-                            2048] ^= 0xBD8D;
-            }
-            offset++;
-        }
+
+        SDL_Rect rect = {0, first * scale, display_w, (y - first) * scale};
+        SDL_UpdateTexture(texture, &rect, pixels + first * scale * display_w,
+                          display_w * 2);
     }
 }
 
-#ifndef NDEBUG
-std::string disassemble(uint16_t opcode)
+/**
+ * @brief audio callback, tops the device stream up from the beeper ring
+ */
+void feed(void *userdata, SDL_AudioStream *stream, int additional, int total)
 {
-    opcode = (opcode >> 8) | (opcode << 8); // little-endian to big-endian
-
-    std::cout << std::format("{:0>2x} {:0>2x} ", (opcode >> 8),
-                             (opcode & 0xFF));
-
-    uint8_t nibble = opcode >> 12;
-
-    if (opcode == 0xEE)
-        return std::format("ret");
-    else if (opcode == 0xE0)
-        return std::format("clear");
-    else if (nibble == 0x0)
-        return std::format("0NNN");
-
-    if (nibble == 0x8) {
-        if ((opcode & 0xF) == 0x0)
-            return std::format("mov v{:x} v{:x}", (opcode & 0xF00) >> 8,
-                               (opcode & 0xF0) >> 4);
-        else if ((opcode & 0xF) == 0x1)
-            return std::format("and v{:x} v{:x}", (opcode & 0xF00) >> 8,
-                               (opcode & 0xF0) >> 4);
-        else if ((opcode & 0xF) == 0x2)
-            return std::format("or v{:x} v{:x}", (opcode & 0xF00) >> 8,
-                               (opcode & 0xF0) >> 4);
-        else if ((opcode & 0xF) == 0x3)
-            return std::format("xor v{:x} v{:x}", (opcode & 0xF00) >> 8,
-                               (opcode & 0xF0) >> 4);
-        else if ((opcode & 0xF) == 0x4)
-            return std::format("add v{:x} v{:x}", (opcode & 0xF00) >> 8,
-                               (opcode & 0xF0) >> 4);
-        else if ((opcode & 0xF) == 0x5)
-            return std::format("sub v{:x} v{:x}", (opcode & 0xF00) >> 8,
-                               (opcode & 0xF0) >> 4);
-        else if ((opcode & 0xF) == 0x6)
-            return std::format("shr v{:x}", (opcode & 0xF00) >> 8);
-        else if ((opcode & 0xF) == 0x7)
-            return std::format("sub v{:x} v{:x}\n	neg v{:x}",
-                               (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4,
-                               (opcode & 0xF00) >> 8);
-        else if ((opcode & 0xF) == 0xE)
-            return std::format("shl v{:x}", (opcode & 0xF00) >> 8);
+    beeper &beep = *(beeper *)userdata;
+    float samples[512];
+
+    for (int left = additional / (int)sizeof(float); left > 0;) {
+        int n = std::min(left, 512);
+        beep.read(samples, n);
+        SDL_PutAudioStreamData(stream, samples, n * sizeof(float));
+        left -= n;
     }
+}
 
-    if (nibble == 0xe) {
-        if ((opcode & 0xFF) == 0x9e)
-            return std::format("keq");
-        else if ((opcode & 0xFF) == 0xa1)
-            return std::format("knq");
+/**
+ * @brief print the spread of key to present latencies on stderr
+ */
+void report(std::vector<uint64_t> &latencies)
+{
+    if (latencies.empty()) {
+        std::cerr << "latency: no key presses reached the display"
+                  << std::endl;
+        return;
     }
 
-    if (nibble == 0xf) {
-        if ((opcode & 0xF) == 0xa)
-            return std::format("waitk");
-        else if ((opcode & 0xFF) == 0x1e)
-            return std::format("add i v{:x}", (opcode & 0xF00) >> 8);
-        else if ((opcode & 0xFF) == 0x7)
-            return std::format("mov v{:x} delay", (opcode & 0xF00) >> 8);
-        else if ((opcode & 0xFF) == 0x15)
-            return std::format("mov delay v{:x}", (opcode & 0xF00) >> 8);
-        else if ((opcode & 0xFF) == 0x18)
-            return std::format("mov sound v{:x}", (opcode & 0xF00) >> 8);
-        else if ((opcode & 0xFF) == 0x29)
-            return std::format("mov i, font[v{:x}]", (opcode & 0xF00) >> 8);
-        else if ((opcode & 0xFF) == 0x33)
-            return std::format("movbcd v{:x}", (opcode & 0xF00) >> 8);
-        else if ((opcode & 0xFF) == 0x55)
-            return std::format("regdump");
-        else if ((opcode & 0xFF) == 0x65)
-            return std::format("regload");
-    }
+    std::sort(latencies.begin(), latencies.end());
 
-    switch (nibble) {
-    case 0x1:
-        return std::format("jmp ${:x}", opcode & 0xFFF);
-    case 0x2:
-        return std::format("call ${:x}", opcode & 0xFFF);
-    case 0x3:
-        return std::format("beq v{:x} #{:x}", (opcode & 0xF00) >> 8,
-                           opcode & 0xFF);
-    case 0x4:
-        return std::format("bnq v{:x} #{:x}", (opcode & 0xF00) >> 8,
-                           opcode & 0xFF);
-    case 0x5:
-        return std::format("beq v{:x} v{:x}", (opcode & 0xF00) >> 8,
-                           (opcode & 0xF0) >> 4);
-    case 0x6:
-        return std::format("mov v{:x} #{:x}", (opcode & 0xF00) >> 8,
-                           opcode & 0xFF);
-    case 0x7:
-        return std::format("add v{:x} #{:x}", (opcode & 0xF00) >> 8,
-                           opcode & 0xFF);
-    case 0x9:
-        return std::format("bnq v{:x} v{:x}", (opcode & 0xF00) >> 8,
-                           (opcode & 0xF0) >> 4);
-    case 0xa:
-        return std::format("mov i ${:x}", opcode & 0xFFF);
-    case 0xb:
-        return std::format("add v0 #{:x}\n	mov pc v0", opcode & 0xFFF);
-    case 0xc:
-        return std::format("rand v{:x} #{:x}", (opcode & 0xF00) >> 8,
-                           opcode & 0xFF);
-    case 0xd:
-        return std::format("draw v{:x} v{:x} #{:x}", (opcode & 0xF00) >> 8,
-                           (opcode & 0xF0) >> 4, opcode & 0xF);
-    default:
-        break;
-    }
+    auto ms = [&](size_t percent) {
+        return latencies[(latencies.size() - 1) * percent / 100] / 1e6;
+    };
 
-    return "undefined";
+    std::cerr << std::format("latency: {} presses, min {:.2f} ms, median "
+                             "{:.2f} ms, p95 {:.2f} ms, max {:.2f} ms",
+                             latencies.size(), ms(0), ms(50), ms(95),
+                             ms(100))
+              << std::endl;
 }
-#endif
@@ -0,0 +1,137 @@
+#include <algorithm>
+
+#include "pool.h"
+
+static uint64_t pack(uint32_t begin, uint32_t end)
+{
+    return (uint64_t)end << 32 | begin;
+}
+
+work_pool::work_pool(size_t threads)
+    : slots(std::max<size_t>(
+          threads ? threads : std::thread::hardware_concurrency(), 1))
+{
+    for (size_t n = 1; n < slots.size(); n++)
+        this->threads.emplace_back(&work_pool::loop, this, n);
+}
+
+work_pool::~work_pool()
+{
+    stop.store(true, std::memory_order_relaxed);
+    batch.fetch_add(1, std::memory_order_release);
+    batch.notify_all();
+
+    for (std::thread &t : threads)
+        t.join();
+}
+
+void work_pool::run(size_t count, pool_task task, void *context)
+{
+    if (count == 0)
+        return;
+
+    // waking the workers costs more than a single item
+    if (threads.empty() || count == 1) {
+        for (size_t n = 0; n < count; n++)
+            task(context, n);
+        return;
+    }
+
+    this->task = task;
+    this->context = context;
+
+    size_t n = slots.size();
+    for (size_t s = 0; s < n; s++)
+        slots[s].range.store(pack(count * s / n, count * (s + 1) / n),
+                             std::memory_order_relaxed);
+
+    active.store(threads.size(), std::memory_order_relaxed);
+    batch.fetch_add(1, std::memory_order_release);
+    batch.notify_all();
+
+    work(0);
+
+    // items only finish before the worker that took them checks out
+    for (size_t left; (left = active.load(std::memory_order_acquire));)
+        active.wait(left, std::memory_order_acquire);
+}
+
+void work_pool::loop(size_t self)
+{
+    uint64_t seen = 0;
+
+    for (;;) {
+        batch.wait(seen, std::memory_order_acquire);
+        seen = batch.load(std::memory_order_acquire);
+
+        if (stop.load(std::memory_order_relaxed))
+            return;
+
+        work(self);
+
+        if (active.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            active.notify_one();
+    }
+}
+
+void work_pool::work(size_t self)
+{
+    // nothing left to steal means every item is taken, the ones still
+    // running finish on the threads that took them
+    for (size_t index;;) {
+        if (take(self, index))
+            task(context, index);
+        else if (!steal(self))
+            return;
+    }
+}
+
+bool work_pool::take(size_t self, size_t &index)
+{
+    std::atomic<uint64_t> &range = slots[self].range;
+    uint64_t r = range.load(std::memory_order_acquire);
+
+    for (;;) {
+        uint32_t begin = r;
+        uint32_t end = r >> 32;
+
+        if (begin >= end)
+            return false;
+
+        if (range.compare_exchange_weak(r, pack(begin + 1, end),
+                                        std::memory_order_acq_rel)) {
+            index = begin;
+            return true;
+        }
+    }
+}
+
+bool work_pool::steal(size_t self)
+{
+    size_t n = slots.size();
+
+    for (size_t k = 1; k < n; k++) {
+        std::atomic<uint64_t> &range = slots[(self + k) % n].range;
+        uint64_t r = range.load(std::memory_order_acquire);
+
+        for (;;) {
+            uint32_t begin = r;
+            uint32_t end = r >> 32;
+
+            if (begin >= end)
+                break;
+
+            // the back half, the owner keeps working from the front
+            uint32_t mid = end - (end - begin + 1) / 2;
+            if (range.compare_exchange_weak(r, pack(begin, mid),
+                                            std::memory_order_acq_rel)) {
+                // thieves leave an empty range alone, so this is safe
+                slots[self].range.store(pack(mid, end),
+                                        std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
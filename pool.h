@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief runs one item of a batch, index counts from 0
+ */
+typedef void (*pool_task)(void *context, size_t index);
+
+/**
+ * @brief fixed set of threads that split a batch of independent items
+ *
+ * Each run() hands every worker, the calling thread included, an equal
+ * range of the batch. Workers take items from the front of their own range
+ * and once it is empty steal the back half of someone else's, so a few
+ * slow items do not leave the other cores idle. Ranges are two 32 bit
+ * bounds in one atomic word, taking and stealing are single compare and
+ * swaps. Between batches the threads sleep on the batch counter.
+ */
+class work_pool
+{
+public:
+    /**
+     * @brief threads counts the caller, 0 uses every hardware thread
+     */
+    explicit work_pool(size_t threads = 0);
+    ~work_pool();
+
+    work_pool(const work_pool &) = delete;
+    work_pool &operator=(const work_pool &) = delete;
+
+    size_t size() const { return slots.size(); }
+
+    /**
+     * @brief call task for every index below count and return once all of
+     * them are done, only one run() at a time
+     */
+    void run(size_t count, pool_task task, void *context);
+
+    template <typename F> void run(size_t count, F &&f)
+    {
+        run(
+            count,
+            [](void *context, size_t index) { (*(F *)context)(index); },
+            (void *)&f);
+    }
+
+private:
+    struct alignas(64) slot {
+        std::atomic<uint64_t> range{0}; // end << 32 | begin
+    };
+
+    void loop(size_t self);
+    void work(size_t self);
+    bool take(size_t self, size_t &index);
+    bool steal(size_t self);
+
+    std::vector<slot> slots;
+    std::vector<std::thread> threads;
+
+    pool_task task = nullptr;
+    void *context = nullptr;
+
+    // bumped once per batch, workers still in a batch
+    alignas(64) std::atomic<uint64_t> batch{0};
+    alignas(64) std::atomic<size_t> active{0};
+    std::atomic<bool> stop{false};
+};
@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iterator>
+
+#include "chip8.h"
+#include "profile.h"
+
+static const char *const op_names[] = {
+    "decode", "nop",  "00E0", "00EE", "1NNN", "2NNN", "3XNN", "4XNN",
+    "5XY0",   "6XNN", "7XNN", "8XY0", "8XY1", "8XY2", "8XY3", "8XY4",
+    "8XY5",   "8XY6", "8XY7", "8XYE", "9XY0", "ANNN", "BNNN", "CXNN",
+    "DXYN",   "EX9E", "EXA1", "FX07", "FX0A", "FX15", "FX18", "FX1E",
+    "FX29",   "FX33", "FX55", "FX65", "00CN", "00DN", "00FB", "00FC",
+    "00FD",   "00FE", "00FF", "5XY2", "5XY3", "F000", "FN01", "F002",
+    "FX3A",   "FX30", "FX75", "FX85",
+};
+
+static_assert(std::size(op_names) == op_count, "an opcode has no name");
+static_assert(op_count <= 64, "profile::ops is too small");
+
+void profile::frame(uint64_t executed)
+{
+    frames++;
+    instructions += executed;
+    ipf_min = std::min(ipf_min, executed);
+    ipf_max = std::max(ipf_max, executed);
+}
+
+bool profile::dump(const char *path) const
+{
+    std::ofstream f(path);
+
+    if (!f.is_open())
+        return false;
+
+    f << "{\n  \"frames\": " << frames << ",\n  \"instructions\": "
+      << instructions << ",\n";
+    f << std::format("  \"ipf\": {{\"min\": {}, \"max\": {}, \"mean\": "
+                     "{:.2f}}},\n",
+                     frames ? ipf_min : 0, ipf_max,
+                     frames ? (double)instructions / frames : 0.0);
+    f << "  \"cpu_ns\": " << cpu_ns << ",\n  \"render_ns\": " << render_ns
+      << ",\n";
+
+    f << "  \"ops\": {";
+    for (size_t op = 0; op < op_count; op++)
+        f << (op ? ", " : "") << "\"" << op_names[op] << "\": " << ops[op];
+    f << "},\n";
+
+    // sparse, only addresses that ran
+    f << "  \"pc_hits\": {";
+    bool first = true;
+    for (size_t pc = 0; pc < 4096; pc++) {
+        if (!pc_hits[pc])
+            continue;
+        f << (first ? "" : ", ") << std::format("\"{:03x}\": ", pc)
+          << pc_hits[pc];
+        first = false;
+    }
+    f << "}\n}" << std::endl;
+
+    return f.good();
+}
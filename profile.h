@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief profiled(...) keeps its argument only in -DCHIP8_PROFILE builds,
+ * everything else compiles away
+ */
+#ifdef CHIP8_PROFILE
+#define profiled(...) __VA_ARGS__
+#else
+#define profiled(...)
+#endif
+
+/**
+ * @brief per-machine counters, op_decode counts predecode cache misses
+ */
+struct profile {
+    uint64_t ops[64] = {};
+    uint64_t pc_hits[4096] = {};
+
+    uint64_t frames = 0;
+    uint64_t instructions = 0;
+    uint64_t ipf_min = UINT64_MAX;
+    uint64_t ipf_max = 0;
+
+    uint64_t cpu_ns = 0;
+    uint64_t render_ns = 0;
+
+    void frame(uint64_t executed);
+
+    /**
+     * @brief write the counters as JSON, false if the file cannot be written
+     */
+    bool dump(const char *path) const;
+};
+
+/**
+ * @brief adds the lifetime of the scope to a nanosecond counter
+ */
+struct profile_timer {
+    uint64_t &total;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    ~profile_timer()
+    {
+        total += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+    }
+};
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "rom.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::~mapped_file()
+{
+    if (base && copy.empty())
+        munmap((void *)base, length);
+}
+
+bool mapped_file::open(const char *path)
+{
+    int fd = ::open(path, O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    void *p = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping stays valid without the descriptor
+    close(fd);
+
+    if (p == MAP_FAILED)
+        return false;
+
+    base = (const uint8_t *)p;
+    length = st.st_size;
+    return true;
+}
+#else
+mapped_file::~mapped_file() {}
+
+bool mapped_file::open(const char *path)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+
+    if (!f.is_open())
+        return false;
+
+    copy.resize(f.tellg());
+    f.seekg(0);
+
+    if (copy.empty() || !f.read((char *)copy.data(), copy.size()))
+        return false;
+
+    base = copy.data();
+    length = copy.size();
+    return true;
+}
+#endif
+
+bool rom_library::open(const char *path)
+{
+    header = nullptr;
+    index = nullptr;
+
+    if (!file.open(path) || file.size() < sizeof(library_header))
+        return false;
+
+    const library_header *h = (const library_header *)file.data();
+
+    if (h->magic != library_magic || h->version != library_version ||
+        h->count > (file.size() - sizeof(library_header)) /
+                       sizeof(library_entry))
+        return false;
+
+    const library_entry *e =
+        (const library_entry *)(file.data() + sizeof(library_header));
+
+    // every later access trusts the index, so check all of it up front
+    for (uint32_t n = 0; n < h->count; n++) {
+        if (e[n].size == 0 || e[n].size > rom_max ||
+            e[n].size > file.size() ||
+            e[n].offset > file.size() - e[n].size ||
+            e[n].name_size > file.size() ||
+            e[n].name > file.size() - e[n].name_size)
+            return false;
+        if (n > 0 && e[n - 1].hash >= e[n].hash)
+            return false;
+    }
+
+    header = h;
+    index = e;
+    return true;
+}
+
+const library_entry *rom_library::find(uint64_t hash) const
+{
+    const library_entry *end = index + count();
+    const library_entry *e = std::lower_bound(
+        index, end, hash,
+        [](const library_entry &e, uint64_t h) { return e.hash < h; });
+
+    return e != end && e->hash == hash ? e : nullptr;
+}
+
+const library_entry *rom_library::find(std::string_view name) const
+{
+    for (size_t n = 0; n < count(); n++)
+        if (this->name(index[n]) == name)
+            return &index[n];
+
+    return nullptr;
+}
+
+bool pack_library(const char *path, const std::vector<std::string> &roms)
+{
+    struct packed {
+        library_entry entry;
+        std::string name;
+        std::vector<uint8_t> image;
+    };
+
+    std::vector<packed> entries;
+
+    for (const std::string &rom : roms) {
+        mapped_file f;
+
+        if (!f.open(rom.c_str()) || f.size() > rom_max)
+            return false;
+
+        packed p = {};
+        p.entry.hash = rom_hash(f.data(), f.size());
+        p.name = rom.substr(rom.find_last_of('/') + 1);
+        p.image.assign(f.data(), f.data() + f.size());
+        entries.push_back(std::move(p));
+    }
+
+    // sorted for binary search, the first name wins for duplicate content
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const packed &a, const packed &b) {
+                         return a.entry.hash < b.entry.hash;
+                     });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const packed &a, const packed &b) {
+                                  return a.entry.hash == b.entry.hash;
+                              }),
+                  entries.end());
+
+    size_t offset =
+        sizeof(library_header) + entries.size() * sizeof(library_entry);
+
+    for (packed &p : entries) {
+        p.entry.offset = offset;
+        p.entry.size = p.image.size();
+        offset += p.image.size();
+
+        p.entry.name = offset;
+        p.entry.name_size = p.name.size();
+        offset += p.name.size();
+    }
+
+    if (offset > UINT32_MAX)
+        return false;
+
+    std::ofstream f(path, std::ios::binary);
+
+    if (!f.is_open())
+        return false;
+
+    library_header header = {library_magic, library_version,
+                             (uint32_t)entries.size(), 0};
+    f.write((const char *)&header, sizeof(header));
+
+    for (const packed &p : entries)
+        f.write((const char *)&p.entry, sizeof(p.entry));
+
+    for (const packed &p : entries) {
+        f.write((const char *)p.image.data(), p.image.size());
+        f.write(p.name.data(), p.name.size());
+    }
+
+    return f.good();
+}
+
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    for (size_t j = 0; j < size; j++) {
+        hash ^= bytes[j];
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+uint64_t rom_hash(const uint8_t *data, size_t size)
+{
+    return fnv1a(data, size);
+}
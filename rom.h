@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chip8.h"
+
+// largest image that fits .text
+#define rom_max (font_addr - entry_point)
+
+#define library_magic 0x424C3843 // "C8LB"
+#define library_version 1
+
+/**
+ * @brief read-only view of a whole file, mapped where the host has mmap
+ */
+class mapped_file
+{
+public:
+    mapped_file() = default;
+    ~mapped_file();
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    /**
+     * @brief false if the file cannot be read or is empty
+     */
+    bool open(const char *path);
+
+    const uint8_t *data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t *base = nullptr;
+    size_t length = 0;
+    std::vector<uint8_t> copy; // hosts without mmap
+};
+
+/**
+ * @brief rom library layout
+ * header  u32 magic, u32 version, u32 count, u32 reserved
+ * index   count library_entry, sorted by hash
+ * data    rom images and names, identical roms are stored once
+ */
+struct library_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct library_entry {
+    uint64_t hash; // rom_hash() of the image
+    uint32_t offset;
+    uint32_t size;
+    uint32_t name; // offset of the file name the rom was packed from
+    uint32_t name_size;
+};
+
+/**
+ * @brief many roms in one mapped file, opening it checks the whole index
+ * once so lookups and loads afterwards cost no i/o
+ */
+class rom_library
+{
+public:
+    bool open(const char *path);
+
+    size_t count() const { return header ? header->count : 0; }
+    const library_entry &entry(size_t n) const { return index[n]; }
+
+    /**
+     * @brief the rom with this content hash, null if there is none
+     */
+    const library_entry *find(uint64_t hash) const;
+
+    /**
+     * @brief the first rom packed from a file with this name, null if none
+     */
+    const library_entry *find(std::string_view name) const;
+
+    const uint8_t *rom(const library_entry &e) const
+    {
+        return file.data() + e.offset;
+    }
+
+    std::string_view name(const library_entry &e) const
+    {
+        return {(const char *)file.data() + e.name, e.name_size};
+    }
+
+private:
+    mapped_file file;
+    const library_header *header = nullptr;
+    const library_entry *index = nullptr;
+};
+
+/**
+ * @brief write the roms at paths into a library, false if one is missing,
+ * too large or the library cannot be written
+ */
+bool pack_library(const char *path, const std::vector<std::string> &roms);
+
+#define fnv_basis 0xcbf29ce484222325
+
+/**
+ * @brief 64 bit FNV-1a of size bytes, continuing from hash
+ */
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash = fnv_basis);
+
+/**
+ * @brief 64 bit FNV-1a of a rom image, the library's content key
+ */
+uint64_t rom_hash(const uint8_t *data, size_t size);
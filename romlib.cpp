@@ -0,0 +1,45 @@
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "rom.h"
+
+int main(int argc, char *argv[])
+{
+    std::string command = argc > 2 ? argv[1] : "";
+
+    if (command != "pack" && command != "list") {
+        std::cerr << "Usage: pack <library> <rom>...\n"
+                     "       list <library>"
+                  << std::endl;
+        return 1;
+    }
+
+    if (command == "pack") {
+        std::vector<std::string> roms(argv + 3, argv + argc);
+
+        if (!pack_library(argv[2], roms)) {
+            std::cerr << "Error: cannot pack " << argv[2] << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    rom_library library;
+
+    if (!library.open(argv[2])) {
+        std::cerr << "Error: invalid library" << std::endl;
+        return 1;
+    }
+
+    for (size_t n = 0; n < library.count(); n++) {
+        const library_entry &e = library.entry(n);
+        std::cout << std::format("{:0>16x} {:>5} {}", e.hash, e.size,
+                                 library.name(e))
+                  << "\n";
+    }
+
+    return 0;
+}
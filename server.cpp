@@ -0,0 +1,574 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "stream.h"
+#include "vm.h"
+
+// frames a late timer catches up on at once, the rest are dropped
+#define max_catch_up 4
+
+/**
+ * @brief a frame the client has, or will have once it reads its socket
+ */
+struct kept_frame {
+    uint32_t frame;
+    bool hires;
+    display_row rows[display_planes][display_h];
+};
+
+/**
+ * @brief one connection and the machine it drives
+ */
+struct session {
+    int fd;
+    size_t slot; // the session's machine and keys
+
+    // kept[acked] is the frame the client acked last and the in_flight
+    // frames after it in the ring were sent but are not acked yet
+    kept_frame kept[stream_window + 1] = {};
+    size_t acked = 0;
+    size_t in_flight = 0;
+    uint32_t next = 1;
+
+    // the machine drew since the last frame kept, or may have
+    bool pending = false;
+
+    std::vector<uint8_t> in;
+    std::vector<uint8_t> out;
+    size_t out_at = 0;
+    bool polling_out = false;
+};
+
+/**
+ * @brief many sessions of one rom behind one socket, multiplexed on a
+ * single epoll loop
+ *
+ * A 60 Hz timer steps every session's machine at once across a work pool.
+ * After each step a session whose framebuffer changed sends the new frame
+ * as a delta against the last frame its client acked, at most
+ * stream_window of them ahead of the acks, so a slow client is sent fewer
+ * frames rather than a growing backlog. Sessions that draw nothing send
+ * nothing, and with no sessions the timer is disarmed.
+ */
+class server
+{
+public:
+    server(vm &start, size_t threads) : start(start), pool(threads) {}
+    ~server();
+
+    /**
+     * @brief listen on a unix socket path or on host:port, host may be
+     * empty for every interface
+     */
+    bool open(const std::string &address);
+
+    /**
+     * @brief serve until SIGINT or SIGTERM, or until max_frames frames
+     * were stepped if it is not 0
+     */
+    bool run(uint64_t max_frames);
+
+    uint64_t frames = 0;
+    uint64_t accepted = 0;
+    uint64_t updates = 0;
+    uint64_t delta_bytes = 0;
+
+private:
+    void accept_all();
+    bool receive(session &s);
+    bool flush(session &s);
+    void update(session &s);
+    void step();
+    void drop(session &s);
+    void arm(bool on);
+
+    vm &start;
+    work_pool pool;
+
+    std::vector<vm> machines;
+    std::vector<uint16_t> keys;
+    std::vector<observation> seen;
+    std::vector<std::unique_ptr<session>> sessions;
+    std::vector<session *> by_fd;
+
+    int epoll = -1;
+    int listener = -1;
+    int timer = -1;
+    int signals = -1;
+    std::string socket_path;
+};
+
+static bool watch(int epoll, int fd, uint32_t events, int op = EPOLL_CTL_ADD);
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: <filepath> [--listen <path|host:port>] "
+                     "[--ipf <n>] [--quirks <profile>]\n"
+                     "       [--threads <n>] [--frames <n>]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string address = "chip8.sock";
+    size_t ipf = default_ipf;
+    size_t threads = 0;
+    uint64_t max_frames = 0;
+    quirk_profile profile = quirks_modern;
+
+    for (int arg = 2; arg < argc; arg++) {
+        std::string opt = argv[arg];
+        if (opt == "--listen" && arg + 1 < argc)
+            address = argv[++arg];
+        else if (opt == "--ipf" && arg + 1 < argc)
+            ipf = std::stoul(argv[++arg]);
+        else if (opt == "--threads" && arg + 1 < argc)
+            threads = std::stoul(argv[++arg]);
+        else if (opt == "--frames" && arg + 1 < argc)
+            max_frames = std::stoull(argv[++arg]);
+        else if (opt == "--quirks" && arg + 1 < argc) {
+            if (!find_profile(argv[++arg], profile)) {
+                std::cerr << "Error: unknown quirk profile " << argv[arg]
+                          << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Error: unknown option " << opt << std::endl;
+            return 1;
+        }
+    }
+
+    if (ipf == 0) {
+        std::cerr << "Error: ipf must be at least 1" << std::endl;
+        return 1;
+    }
+
+    vm start;
+
+    if (!start.load(argv[1], profile)) {
+        std::cerr << "Error: invalid file" << std::endl;
+        return 1;
+    }
+
+    start.ipf = ipf;
+
+    server host(start, threads);
+
+    if (!host.open(address)) {
+        std::cerr << "Error: cannot listen on " << address << std::endl;
+        return 1;
+    }
+
+    if (!host.run(max_frames)) {
+        std::cerr << "Error: " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::cout << std::format("frames {}\n", host.frames)
+              << std::format("sessions {}\n", host.accepted)
+              << std::format("updates {}\n", host.updates)
+              << std::format("bytes {} ({:.1f} per update)\n",
+                             host.delta_bytes,
+                             host.updates ? (double)host.delta_bytes /
+                                                host.updates
+                                          : 0.0);
+
+    return 0;
+}
+
+server::~server()
+{
+    for (auto &s : sessions)
+        close(s->fd);
+
+    for (int fd : {listener, timer, signals, epoll})
+        if (fd >= 0)
+            close(fd);
+
+    if (!socket_path.empty())
+        unlink(socket_path.c_str());
+}
+
+bool server::open(const std::string &address)
+{
+    size_t colon = address.rfind(':');
+
+    if (colon == std::string::npos) {
+        sockaddr_un to = {};
+        to.sun_family = AF_UNIX;
+
+        if (address.size() >= sizeof(to.sun_path))
+            return false;
+        memcpy(to.sun_path, address.c_str(), address.size());
+
+        // a socket left over from an earlier run, nothing else
+        struct stat st;
+        if (stat(address.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+            unlink(address.c_str());
+
+        listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          0);
+        if (listener < 0 || bind(listener, (sockaddr *)&to, sizeof(to)) < 0)
+            return false;
+
+        socket_path = address;
+    } else {
+        std::string host = address.substr(0, colon);
+        std::string port = address.substr(colon + 1);
+
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+
+        addrinfo *found;
+        if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(),
+                        &hints, &found) != 0)
+            return false;
+
+        listener = socket(found->ai_family,
+                          SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        int on = 1;
+        bool bound = listener >= 0 &&
+                     setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on,
+                                sizeof(on)) == 0 &&
+                     bind(listener, found->ai_addr, found->ai_addrlen) == 0;
+        freeaddrinfo(found);
+
+        if (!bound)
+            return false;
+    }
+
+    if (listen(listener, SOMAXCONN) < 0)
+        return false;
+
+    // SIGINT and SIGTERM end the loop instead of the process
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+
+    signals = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+
+    return signals >= 0 && timer >= 0 && epoll >= 0 &&
+           watch(epoll, listener, EPOLLIN) && watch(epoll, timer, EPOLLIN) &&
+           watch(epoll, signals, EPOLLIN);
+}
+
+bool server::run(uint64_t max_frames)
+{
+    epoll_event events[64];
+
+    while (!max_frames || frames < max_frames) {
+        int ready = epoll_wait(epoll, events, 64, -1);
+
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        for (int n = 0; n < ready; n++) {
+            int fd = events[n].data.fd;
+
+            if (fd == signals)
+                return true;
+
+            if (fd == listener) {
+                accept_all();
+                continue;
+            }
+
+            if (fd == timer) {
+                uint64_t due = 0;
+                if (read(timer, &due, sizeof(due)) != sizeof(due))
+                    continue;
+
+                for (due = std::min<uint64_t>(due, max_catch_up); due; due--)
+                    if (!max_frames || frames < max_frames)
+                        step();
+                continue;
+            }
+
+            session *s = (size_t)fd < by_fd.size() ? by_fd[fd] : nullptr;
+
+            // dropped earlier in this batch
+            if (!s)
+                continue;
+
+            uint32_t e = events[n].events;
+            bool alive = !(e & (EPOLLERR | EPOLLHUP));
+
+            if (alive && (e & EPOLLIN))
+                alive = receive(*s);
+            if (alive && (e & EPOLLOUT))
+                alive = flush(*s);
+            if (!alive)
+                drop(*s);
+        }
+    }
+
+    return true;
+}
+
+void server::accept_all()
+{
+    for (;;) {
+        int fd = accept4(listener, nullptr, nullptr,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (fd < 0)
+            return;
+
+        // updates are small and latency bound, fails harmlessly on unix
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        if (!watch(epoll, fd, EPOLLIN)) {
+            close(fd);
+            continue;
+        }
+
+        std::unique_ptr<session> s(new session);
+        s->fd = fd;
+        s->slot = sessions.size();
+
+        machines.push_back(start.clone());
+        keys.push_back(0);
+
+        if ((size_t)fd >= by_fd.size())
+            by_fd.resize(fd + 1, nullptr);
+        by_fd[fd] = s.get();
+
+        stream_hello hello = {stream_magic,  stream_version, display_w,
+                              display_h,     display_planes, stream_window};
+        const uint8_t *bytes = (const uint8_t *)&hello;
+        s->out.assign(bytes, bytes + sizeof(hello));
+
+        sessions.push_back(std::move(s));
+        accepted++;
+
+        if (sessions.size() == 1)
+            arm(true);
+
+        if (!flush(*sessions.back()))
+            drop(*sessions.back());
+    }
+}
+
+bool server::receive(session &s)
+{
+    uint8_t buffer[4096];
+
+    for (;;) {
+        ssize_t got = recv(s.fd, buffer, sizeof(buffer), 0);
+
+        if (got == 0)
+            return false;
+        if (got < 0)
+            break;
+
+        s.in.insert(s.in.end(), buffer, buffer + got);
+    }
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+        return false;
+
+    size_t used = 0;
+
+    for (; s.in.size() - used >= sizeof(stream_input);
+         used += sizeof(stream_input)) {
+        stream_input msg;
+        memcpy(&msg, s.in.data() + used, sizeof(msg));
+
+        if (msg.type == input_keys)
+            keys[s.slot] = msg.keys;
+        else if (msg.type == input_reset) {
+            machines[s.slot].reset(msg.value);
+            s.pending = true;
+        } else if (msg.type == input_ack) {
+            // acks for frames no longer in flight are stale, skip them
+            for (size_t k = 1; k <= s.in_flight; k++) {
+                size_t at = (s.acked + k) % (stream_window + 1);
+                if (s.kept[at].frame == msg.value) {
+                    s.acked = at;
+                    s.in_flight -= k;
+                    break;
+                }
+            }
+        } else
+            return false;
+    }
+
+    s.in.erase(s.in.begin(), s.in.begin() + used);
+
+    // an ack may have opened the window for a frame that was held back
+    update(s);
+    return flush(s);
+}
+
+bool server::flush(session &s)
+{
+    while (s.out_at < s.out.size()) {
+        ssize_t sent = send(s.fd, s.out.data() + s.out_at,
+                            s.out.size() - s.out_at, MSG_NOSIGNAL);
+
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+
+        s.out_at += sent;
+    }
+
+    if (s.out_at == s.out.size()) {
+        s.out.clear();
+        s.out_at = 0;
+    }
+
+    // only wait for the socket to drain while there is something left
+    bool waiting = !s.out.empty();
+
+    if (waiting != s.polling_out) {
+        s.polling_out = waiting;
+        return watch(epoll, s.fd, waiting ? EPOLLIN | EPOLLOUT : EPOLLIN,
+                     EPOLL_CTL_MOD);
+    }
+
+    return true;
+}
+
+void server::update(session &s)
+{
+    if (!s.pending || s.in_flight == stream_window)
+        return;
+
+    const chip8 &c = machines[s.slot].machine();
+    const kept_frame &last =
+        s.kept[(s.acked + s.in_flight) % (stream_window + 1)];
+
+    s.pending = false;
+
+    if (c.hires == last.hires &&
+        memcmp(c.framebuffer, last.rows, sizeof(last.rows)) == 0)
+        return;
+
+    kept_frame &f = s.kept[(s.acked + s.in_flight + 1) % (stream_window + 1)];
+    f.frame = s.next++;
+    f.hires = c.hires;
+    memcpy(f.rows, c.framebuffer, sizeof(f.rows));
+
+    uint8_t delta[stream_max_delta];
+    size_t size = encode_delta((const uint8_t *)f.rows,
+                               (const uint8_t *)s.kept[s.acked].rows, delta);
+
+    stream_update u = {f.frame, s.kept[s.acked].frame,
+                       frame_hash((const uint8_t *)f.rows),
+                       (uint16_t)size, f.hires, {}};
+
+    const uint8_t *header = (const uint8_t *)&u;
+    s.out.insert(s.out.end(), header, header + sizeof(u));
+    s.out.insert(s.out.end(), delta, delta + size);
+
+    s.in_flight++;
+    updates++;
+    delta_bytes += size;
+}
+
+void server::step()
+{
+    frames++;
+
+    if (sessions.empty())
+        return;
+
+    seen.resize(sessions.size());
+    step_batch(pool, machines.data(), keys.data(), seen.data(),
+               machines.size());
+
+    // back to front, a session that fails is swapped with the last one
+    for (size_t n = sessions.size(); n-- > 0;) {
+        session &s = *sessions[n];
+        const kept_frame &last =
+            s.kept[(s.acked + s.in_flight) % (stream_window + 1)];
+
+        if (seen[n].dirty || seen[n].hires != last.hires)
+            s.pending = true;
+
+        update(s);
+
+        if (!flush(s))
+            drop(s);
+    }
+}
+
+void server::drop(session &s)
+{
+    int fd = s.fd;
+    size_t slot = s.slot;
+    size_t last = sessions.size() - 1;
+
+    epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    by_fd[fd] = nullptr;
+
+    if (slot != last) {
+        std::swap(machines[slot], machines[last]);
+        keys[slot] = keys[last];
+        sessions[slot] = std::move(sessions[last]);
+        sessions[slot]->slot = slot;
+    }
+
+    machines.pop_back();
+    keys.pop_back();
+    sessions.pop_back();
+
+    if (sessions.empty())
+        arm(false);
+}
+
+void server::arm(bool on)
+{
+    itimerspec period = {};
+
+    if (on) {
+        period.it_interval.tv_nsec = frame_ns;
+        period.it_value.tv_nsec = frame_ns;
+    }
+
+    timerfd_settime(timer, 0, &period, nullptr);
+}
+
+bool watch(int epoll, int fd, uint32_t events, int op)
+{
+    epoll_event e = {};
+    e.events = events;
+    e.data.fd = fd;
+    return epoll_ctl(epoll, op, fd, &e) == 0;
+}
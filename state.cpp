@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "state.h"
+
+/**
+ * @brief on disk header, followed by the raw snapshot
+ */
+struct state_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+};
+
+void capture(const chip8 &c, snapshot &s)
+{
+    memset(&s, 0, sizeof(s));
+    memcpy(s.mem, c.mem, sizeof(s.mem));
+    memcpy(s.framebuffer, c.framebuffer, sizeof(s.framebuffer));
+    s.rng = c.rng;
+    s.cycles = c.cycles;
+    memcpy(s.v, c.v, sizeof(s.v));
+    memcpy(s.keypad, c.keypad, sizeof(s.keypad));
+    memcpy(s.pattern, c.pattern, sizeof(s.pattern));
+    memcpy(s.flags, c.flags, sizeof(s.flags));
+    s.i = c.i;
+    s.pc = c.pc;
+    s.sp = c.sp;
+    s.rom_end = c.rom_end;
+    s.delay = c.delay;
+    s.sound = c.sound;
+    s.hires = c.hires;
+    s.planes = c.planes;
+    s.pitch = c.pitch;
+    s.profile = c.profile;
+}
+
+void restore(chip8 &c, const snapshot &s)
+{
+    memcpy(c.mem, s.mem, sizeof(s.mem));
+    memcpy(c.framebuffer, s.framebuffer, sizeof(s.framebuffer));
+    c.rng = s.rng;
+    c.cycles = s.cycles;
+    memcpy(c.v, s.v, sizeof(s.v));
+    memcpy(c.keypad, s.keypad, sizeof(s.keypad));
+    memcpy(c.pattern, s.pattern, sizeof(s.pattern));
+    memcpy(c.flags, s.flags, sizeof(s.flags));
+    c.i = s.i;
+    c.pc = s.pc;
+    c.sp = s.sp;
+    c.rom_end = s.rom_end;
+    c.delay = s.delay;
+    c.sound = s.sound;
+    c.hires = s.hires;
+    c.planes = s.planes;
+    c.pitch = s.pitch;
+    c.set_profile((quirk_profile)s.profile);
+
+    c.invalidate(0x0, 4096);
+    c.dirty = ~0ull;
+}
+
+void clone_state(chip8 &dst, const chip8 &src)
+{
+    // translations stop at rom_end, another rom starts from scratch
+    if (dst.rom_end != src.rom_end)
+        dst.invalidate(0x0, 4096);
+
+    // siblings differ in the stack and a few variables, compare a cache
+    // line at a time and drop decodes only where a line changes
+    for (size_t a = 0; a < sizeof(dst.mem); a += 64)
+        if (memcmp(dst.mem + a, src.mem + a, 64)) {
+            memcpy(dst.mem + a, src.mem + a, 64);
+            dst.invalidate(a, 64);
+        }
+
+    memcpy(dst.framebuffer, src.framebuffer, sizeof(dst.framebuffer));
+    dst.rng = src.rng;
+    dst.cycles = src.cycles;
+    memcpy(dst.v, src.v, sizeof(dst.v));
+    memcpy(dst.keypad, src.keypad, sizeof(dst.keypad));
+    memcpy(dst.pattern, src.pattern, sizeof(dst.pattern));
+    memcpy(dst.flags, src.flags, sizeof(dst.flags));
+    dst.i = src.i;
+    dst.pc = src.pc;
+    dst.sp = src.sp;
+    dst.rom_end = src.rom_end;
+    dst.delay = src.delay;
+    dst.sound = src.sound;
+    dst.hires = src.hires;
+    dst.planes = src.planes;
+    dst.pitch = src.pitch;
+    dst.idle = idle_none;
+
+    if (dst.profile != src.profile)
+        dst.set_profile(src.profile);
+
+    dst.dirty = ~0ull;
+}
+
+bool save_state(const chip8 &c, const char *path)
+{
+    std::ofstream f(path, std::ios::binary);
+
+    if (!f.is_open())
+        return false;
+
+    snapshot s;
+    capture(c, s);
+
+    state_header header = {state_magic, state_version, sizeof(s)};
+    f.write((const char *)&header, sizeof(header));
+    f.write((const char *)&s, sizeof(s));
+
+    return f.good();
+}
+
+bool load_state(chip8 &c, const char *path)
+{
+    std::ifstream f(path, std::ios::binary);
+
+    if (!f.is_open())
+        return false;
+
+    state_header header;
+    snapshot s;
+
+    if (!f.read((char *)&header, sizeof(header)))
+        return false;
+
+    if (header.magic != state_magic || header.version != state_version ||
+        header.size != sizeof(s))
+        return false;
+
+    if (!f.read((char *)&s, sizeof(s)) || s.profile >= quirks_count)
+        return false;
+
+    // code is translated up to rom_end and calls write at sp, keep both
+    // inside .text and .stack
+    if (s.rom_end > font_addr || s.sp < 0xEA0 || s.sp > 0xF00)
+        return false;
+
+    restore(c, s);
+    return true;
+}
+
+rewind_buffer::rewind_buffer(size_t bytes)
+    : ring(bytes), scratch(sizeof(snapshot) * 4 + 4)
+{
+}
+
+void rewind_buffer::push(const chip8 &c)
+{
+    capture(c, next);
+
+    if (!primed) {
+        last = next;
+        primed = true;
+        return;
+    }
+
+    // entry = u16 length, (u16 skip, u8 count, count xor bytes)*, u16 length
+    const uint8_t *a = (const uint8_t *)&last;
+    const uint8_t *b = (const uint8_t *)&next;
+    size_t len = 2;
+    size_t pos = 0;
+
+    while (pos < sizeof(snapshot)) {
+        size_t skip = 0;
+        while (pos < sizeof(snapshot) && a[pos] == b[pos] && skip < 0xFFFF) {
+            pos++;
+            skip++;
+        }
+
+        size_t run = 0;
+        uint8_t *out = &scratch[len + 3];
+        while (pos + run < sizeof(snapshot) && run < 0xFF &&
+               a[pos + run] != b[pos + run]) {
+            out[run] = a[pos + run] ^ b[pos + run];
+            run++;
+        }
+
+        if (run == 0 && pos == sizeof(snapshot))
+            break;
+
+        scratch[len + 0] = skip & 0xFF;
+        scratch[len + 1] = skip >> 8;
+        scratch[len + 2] = run;
+        len += 3 + run;
+        pos += run;
+    }
+
+    len += 2;
+    scratch[0] = scratch[len - 2] = len & 0xFF;
+    scratch[1] = scratch[len - 1] = len >> 8;
+
+    if (len > ring.size())
+        return;
+
+    // make room by dropping the oldest frames
+    while (ring.size() - used < len) {
+        size_t old = length_at(tail);
+        tail = (tail + old) % ring.size();
+        used -= old;
+        count--;
+    }
+
+    write(scratch.data(), len);
+    count++;
+
+    last = next;
+}
+
+bool rewind_buffer::pop(chip8 &c)
+{
+    if (count == 0)
+        return false;
+
+    size_t len = length_at((head + ring.size() - 2) % ring.size());
+    size_t start = (head + ring.size() - len) % ring.size();
+    read(start, scratch.data(), len);
+
+    uint8_t *state = (uint8_t *)&last;
+    size_t pos = 0;
+
+    for (size_t j = 2; j < len - 2;) {
+        pos += scratch[j] | (scratch[j + 1] << 8);
+        uint8_t run = scratch[j + 2];
+        j += 3;
+        for (uint8_t k = 0; k < run; k++)
+            state[pos++] ^= scratch[j++];
+    }
+
+    head = start;
+    used -= len;
+    count--;
+
+    restore(c, last);
+    return true;
+}
+
+void rewind_buffer::write(const uint8_t *src, size_t len)
+{
+    size_t first = std::min(len, ring.size() - head);
+    memcpy(&ring[head], src, first);
+    memcpy(&ring[0], src + first, len - first);
+    head = (head + len) % ring.size();
+    used += len;
+}
+
+void rewind_buffer::read(size_t pos, uint8_t *dst, size_t len) const
+{
+    size_t first = std::min(len, ring.size() - pos);
+    memcpy(dst, &ring[pos], first);
+    memcpy(dst + first, &ring[0], len - first);
+}
+
+uint16_t rewind_buffer::length_at(size_t pos) const
+{
+    return ring[pos] | (ring[(pos + 1) % ring.size()] << 8);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "chip8.h"
+
+#define state_magic 0x54533843 // "C8ST"
+#define state_version 3
+
+/**
+ * @brief everything needed to resume a machine, laid out without gaps so it
+ * can be written to disk and xor-diffed as raw bytes
+ */
+struct snapshot {
+    uint8_t mem[4096];
+    display_row framebuffer[display_planes][display_h];
+    uint64_t rng;
+    uint64_t cycles;
+    uint8_t v[16];
+    uint8_t keypad[16];
+    uint8_t pattern[16];
+    uint8_t flags[16];
+    uint16_t i;
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t rom_end;
+    uint8_t delay;
+    uint8_t sound;
+    uint8_t hires;
+    uint8_t planes;
+    uint8_t pitch;
+    uint8_t profile;
+    uint8_t reserved[2];
+};
+
+void capture(const chip8 &c, snapshot &s);
+void restore(chip8 &c, const snapshot &s);
+
+/**
+ * @brief copy everything a snapshot holds from src into dst, memory that
+ * already matches keeps its decodes and translations
+ */
+void clone_state(chip8 &dst, const chip8 &src);
+
+/**
+ * @brief save/load a snapshot file, false on io errors or a version mismatch
+ */
+bool save_state(const chip8 &c, const char *path);
+bool load_state(chip8 &c, const char *path);
+
+/**
+ * @brief fixed-size history of per-frame snapshots for rewinding
+ *
+ * Each push stores the xor of the new snapshot against the previous one,
+ * run-length encoded, so a frame that only moved a sprite costs a few dozen
+ * bytes. Popping xors the newest delta back out of the current snapshot.
+ * The oldest frames are dropped once the ring is full. All buffers are
+ * allocated up front.
+ */
+class rewind_buffer
+{
+public:
+    explicit rewind_buffer(size_t bytes = 4 << 20);
+
+    /**
+     * @brief record the state at the end of a frame
+     */
+    void push(const chip8 &c);
+
+    /**
+     * @brief step the machine back one recorded frame, false if none left
+     */
+    bool pop(chip8 &c);
+
+    size_t frames() const { return count; }
+
+private:
+    void write(const uint8_t *src, size_t len);
+    void read(size_t pos, uint8_t *dst, size_t len) const;
+    uint16_t length_at(size_t pos) const;
+
+    std::vector<uint8_t> ring;
+    size_t head = 0; // next byte to write
+    size_t tail = 0; // oldest entry
+    size_t used = 0;
+    size_t count = 0;
+
+    snapshot last;
+    snapshot next;
+    bool primed = false;
+
+    // worst case encoding is a 3 byte header per literal byte
+    std::vector<uint8_t> scratch;
+};
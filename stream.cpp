@@ -0,0 +1,70 @@
+#include <cstring>
+
+#include "rom.h"
+#include "stream.h"
+
+size_t encode_delta(const uint8_t *frame, const uint8_t *base, uint8_t *out)
+{
+    uint8_t x[stream_frame_size];
+    size_t end = 0;
+
+    for (size_t j = 0; j < stream_frame_size; j++) {
+        x[j] = frame[j] ^ base[j];
+        if (x[j])
+            end = j + 1;
+    }
+
+    size_t size = 0;
+
+    for (size_t j = 0; j < end;) {
+        size_t start = j;
+
+        while (j < end && !x[j] && j - start < 128)
+            j++;
+
+        if (j > start) {
+            out[size++] = j - start - 1;
+            continue;
+        }
+
+        // a lone unchanged byte costs less inside a literal than as a skip
+        while (j < end && j - start < 128 && (x[j] || x[j + 1]))
+            j++;
+
+        out[size++] = 0x80 | (j - start - 1);
+        memcpy(out + size, x + start, j - start);
+        size += j - start;
+    }
+
+    return size;
+}
+
+bool apply_delta(uint8_t *frame, const uint8_t *delta, size_t size)
+{
+    size_t at = 0;
+
+    for (size_t n = 0; n < size;) {
+        uint8_t token = delta[n++];
+        size_t count = (token & 0x7F) + 1;
+
+        if (at + count > stream_frame_size)
+            return false;
+
+        if (token & 0x80) {
+            if (count > size - n)
+                return false;
+            for (size_t k = 0; k < count; k++)
+                frame[at + k] ^= delta[n + k];
+            n += count;
+        }
+
+        at += count;
+    }
+
+    return true;
+}
+
+uint64_t frame_hash(const uint8_t *frame)
+{
+    return rom_hash(frame, stream_frame_size);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "display.h"
+
+#define stream_magic 0x53433843 // "C8CS"
+#define stream_version 1
+// updates a session sends before it waits for the client's acks
+#define stream_window 4
+// bytes of framebuffer a delta covers, every plane at hires size
+#define stream_frame_size (display_planes * display_h * sizeof(display_row))
+// longest delta, every byte changed
+#define stream_max_delta (stream_frame_size + stream_frame_size / 128)
+
+/**
+ * @brief framebuffer streaming protocol, little-endian over a stream socket
+ *
+ * The server opens with a stream_hello. Every update after it carries the
+ * changes between a new frame and a base frame the client has acked, as
+ * the two framebuffers xored together and run-length coded: a token byte
+ * t < 0x80 skips t + 1 unchanged bytes, t >= 0x80 is followed by
+ * t - 0x7F bytes to xor in, bytes past the last token are unchanged.
+ * Update numbers count from 1 per connection and update 0 is the blank
+ * lores screen both sides start from.
+ *
+ * The client sends 8 byte stream_input messages: the keypad mask it holds,
+ * an ack for every update it has applied and a reset with a new seed.
+ */
+struct stream_hello {
+    uint32_t magic;
+    uint32_t version;
+    uint16_t width;
+    uint16_t height;
+    uint16_t planes;
+    uint16_t window;
+};
+
+struct stream_update {
+    uint32_t frame;
+    uint32_t base;
+    uint64_t hash; // frame_hash() of the whole new framebuffer
+    uint16_t size; // delta bytes that follow
+    uint8_t hires;
+    uint8_t reserved[5];
+};
+
+enum input_type : uint8_t { input_keys, input_ack, input_reset };
+
+struct stream_input {
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t keys; // input_keys, bit k is key k held
+    uint32_t value; // input_ack the update, input_reset the seed
+};
+
+/**
+ * @brief xor frame against base and run-length code the result into out,
+ * which holds stream_max_delta bytes, returns the bytes written
+ */
+size_t encode_delta(const uint8_t *frame, const uint8_t *base, uint8_t *out);
+
+/**
+ * @brief xor a delta into frame, which holds the base it was coded
+ * against, false if the delta is malformed
+ */
+bool apply_delta(uint8_t *frame, const uint8_t *delta, size_t size);
+
+/**
+ * @brief 64 bit FNV-1a of a framebuffer, the same hash chip8_headless
+ * prints for it
+ */
+uint64_t frame_hash(const uint8_t *frame);
@@ -0,0 +1,108 @@
+#include <format>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "chip8.h"
+
+/**
+ * @brief a hand-written program and what it must leave behind once it has
+ * run to its end
+ */
+struct program {
+    const char *name;
+    std::vector<uint16_t> ops;
+    std::vector<std::pair<uint16_t, uint8_t>> mem;
+    uint16_t i;
+    uint16_t i_load; // i under profiles with the load_i quirk
+};
+
+static bool check(const program &t, quirk_profile p, bool stepped);
+
+int main()
+{
+    const std::vector<program> programs = {
+        // stores over their own opcode, operands must survive the write
+        {"FX55 over itself",
+         {0xA206, 0x6011, 0x6122, 0xF155},
+         {{0x206, 0x11}, {0x207, 0x22}},
+         0x206,
+         0x208},
+        {"FX55 over itself and the next opcode",
+         {0xA206, 0x6011, 0x6122, 0xF355, 0x6344},
+         {{0x206, 0x11}, {0x207, 0x22}, {0x208, 0x0}, {0x209, 0x0}},
+         0x206,
+         0x20A},
+        {"FX33 over itself",
+         {0xA204, 0x60FE, 0xF033},
+         {{0x204, 0x2}, {0x205, 0x5}, {0x206, 0x4}},
+         0x204,
+         0x204},
+        {"5XY2 over itself",
+         {0xA206, 0x6011, 0x6122, 0x5012},
+         {{0x206, 0x11}, {0x207, 0x22}},
+         0x206,
+         0x206},
+        // the rewritten opcode runs instead of the one decoded before
+        {"FX55 over the next opcode",
+         {0xA208, 0x60A3, 0x6121, 0xF155, 0x0000},
+         {{0x208, 0xA3}, {0x209, 0x21}},
+         0x321,
+         0x321},
+    };
+
+    bool ok = true;
+
+    for (const program &t : programs)
+        for (int p = 0; p < quirks_count; p++) {
+            ok &= check(t, (quirk_profile)p, true);
+            ok &= check(t, (quirk_profile)p, false);
+        }
+
+    return ok ? 0 : 1;
+}
+
+bool check(const program &t, quirk_profile p, bool stepped)
+{
+    std::vector<uint8_t> rom;
+    for (uint16_t op : t.ops) {
+        rom.push_back(op >> 8);
+        rom.push_back(op & 0xFF);
+    }
+
+    chip8 c;
+    c.load(rom.data(), rom.size());
+    c.set_profile(p);
+
+    for (size_t n = 0; n < 64 && !c.halted(); n++)
+        if (stepped)
+            c.step();
+        else
+            c.run(1 + n % 3);
+
+    std::string what = std::format("Error: {} under profile {} ({})", t.name,
+                                   (int)p, stepped ? "step" : "run");
+    bool ok = c.halted();
+
+    if (!ok)
+        std::cerr << what << ": did not halt" << std::endl;
+
+    uint16_t i = quirk_sets[p].load_i ? t.i_load : t.i;
+    if (c.i != i) {
+        std::cerr << what << std::format(": i {:x}, expected {:x}", c.i, i)
+                  << std::endl;
+        ok = false;
+    }
+
+    for (auto [at, value] : t.mem)
+        if (c.mem[at] != value) {
+            std::cerr << what
+                      << std::format(": mem[{:x}] {:x}, expected {:x}", at,
+                                     c.mem[at], value)
+                      << std::endl;
+            ok = false;
+        }
+
+    return ok;
+}
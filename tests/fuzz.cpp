@@ -0,0 +1,152 @@
+#include <cstring>
+#include <iostream>
+
+#include "fuzz.h"
+
+std::vector<uint8_t> random_rom(std::mt19937_64 &g)
+{
+    auto r = [&](uint32_t n) { return (uint16_t)(g() % n); };
+
+    size_t size = 16 + r(300) * 2;
+    std::vector<uint8_t> rom;
+
+    auto put = [&](uint16_t op) {
+        rom.push_back(op >> 8);
+        rom.push_back(op & 0xFF);
+    };
+
+    static const uint8_t misc[] = {0x07, 0x0A, 0x15, 0x18, 0x1E, 0x29, 0x33,
+                                   0x55, 0x65, 0x30, 0x3A, 0x75, 0x85, 0x01};
+    static const uint16_t screen[] = {0x00E0, 0x00FB, 0x00FC, 0x00FE,
+                                      0x00FF, 0x00C3, 0x00D2, 0x00FD};
+
+    while (rom.size() < size) {
+        // odd targets and the bytes past the end too
+        uint16_t to = 0x200 + r(size + 2);
+        uint16_t x = r(16);
+        uint16_t y = r(16);
+
+        switch (r(16)) {
+        case 0:
+            put(g());
+            break;
+        case 1:
+            put(0x1000 | to);
+            break;
+        case 2:
+            put(0x2000 | to);
+            break;
+        case 3:
+            put(0x00EE);
+            break;
+        case 4:
+            put((0x3 + r(3)) << 12 | x << 8 | r(4) << 4 | r(4));
+            break;
+        case 5:
+            put(0x8000 | x << 8 | y << 4 | r(16));
+            break;
+        case 6:
+            put(0xA000 | (0x200 + r(0xE00)));
+            put(0xD000 | x << 8 | y << 4 | r(16));
+            break;
+        case 7:
+            put(0xF029 | x << 8);
+            put(0xD005 | x << 8 | y << 4);
+            break;
+        case 8:
+            put((r(2) ? 0xE09E : 0xE0A1) | x << 8);
+            break;
+        case 9:
+            put(0xF000 | x << 8 | misc[r(sizeof(misc))]);
+            break;
+        case 10:
+            put(screen[r(8)]);
+            break;
+        case 11:
+            // a counted loop step
+            put(0x7000 | x << 8 | r(4));
+            put((r(2) ? 0x3000 : 0x4000) | x << 8 | r(8));
+            put(0x1000 | to);
+            break;
+        case 12:
+            // stores over the rom's own code
+            put(0xA000 | (0x200 + r(size + 8)));
+            put(r(3) ? 0xF055 | x << 8 : r(2) ? 0xF033 | x << 8
+                                              : 0x5002 | x << 8 | y << 4);
+            break;
+        case 13:
+            // stores from i past 0xFFF, running over the top of memory or
+            // wrapping onto the rom's code
+            if (r(2)) {
+                put(0xA000 | (0xFF0 + r(0x10)));
+                put(0x6000 | y << 8 | r(0x20));
+                put(0xF01E | y << 8);
+            } else {
+                put(0xF000);
+                put((1 + r(15)) << 12 | (0x200 + r(size + 8)));
+            }
+            put(r(3) ? 0xF055 | x << 8 : r(2) ? 0xF033 | x << 8
+                                              : 0x5002 | x << 8 | y << 4);
+            break;
+        case 14:
+            put(0xC000 | x << 8 | r(256));
+            break;
+        default:
+            for (int k = 1 + r(4); k; k--)
+                put((0x6 + r(2)) << 12 | r(16) << 8 | r(256));
+            break;
+        }
+    }
+
+    return rom;
+}
+
+bool probe(chip8 &c, size_t budget)
+{
+    for (size_t k = 0; k < budget && !c.halted(); k++) {
+        uint16_t at = c.pc & 0xFFF;
+        uint16_t op = c.mem[at] << 8 | c.mem[(at + 1) & 0xFFF];
+
+        if ((op & 0xF0FF) == 0xE09E || (op & 0xF0FF) == 0xE0A1)
+            if (c.v[op >> 8 & 0xF] > 0xF)
+                return false;
+        if ((op & 0xF000) == 0x2000 && c.sp > 0xFFD)
+            return false;
+        if (op == 0x00EE && c.sp < 0x2)
+            return false;
+
+        c.step();
+        c.cycles++;
+    }
+
+    return true;
+}
+
+bool same_state(const snapshot &a, const snapshot &b, const char *what)
+{
+    if (!memcmp(&a, &b, sizeof(a)))
+        return true;
+
+    std::cerr << "Error: " << what << std::hex << ": pc " << a.pc << "/"
+              << b.pc << " i " << a.i << "/" << b.i << " sp " << a.sp << "/"
+              << b.sp << std::dec << " cycles " << a.cycles << "/"
+              << b.cycles;
+
+    for (int x = 0; x < 16; x++)
+        if (a.v[x] != b.v[x])
+            std::cerr << std::hex << " v" << x << " " << +a.v[x] << "/"
+                      << +b.v[x];
+
+    for (int at = 0; at < 4096; at++)
+        if (a.mem[at] != b.mem[at]) {
+            std::cerr << std::hex << " mem[" << at << "] " << +a.mem[at]
+                      << "/" << +b.mem[at];
+            break;
+        }
+
+    if (memcmp(a.framebuffer, b.framebuffer, sizeof(a.framebuffer)))
+        std::cerr << " framebuffer";
+
+    std::cerr << std::dec << std::endl;
+    return false;
+}
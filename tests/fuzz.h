@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "chip8.h"
+#include "state.h"
+
+/**
+ * @brief a random rom for differential tests, mostly valid opcodes with
+ * jumps and calls back into the rom, stores over its own code and stores
+ * near the top of memory where i wraps around
+ */
+std::vector<uint8_t> random_rom(std::mt19937_64 &g);
+
+/**
+ * @brief step c through budget instructions the way run() would, false as
+ * soon as the next one has no defined result (a key past the keypad or a
+ * stack overrun), c is then left before it
+ */
+bool probe(chip8 &c, size_t budget);
+
+/**
+ * @brief compare two snapshots, printing the fields that differ after
+ * what, true if they match
+ */
+bool same_state(const snapshot &a, const snapshot &b, const char *what);
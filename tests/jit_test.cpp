@@ -0,0 +1,81 @@
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "fuzz.h"
+
+/**
+ * @brief runs random roms through the recompiler and the interpreter side by
+ * side and compares the machines after every frame
+ */
+int main(int argc, char *argv[])
+{
+    size_t trials = argc > 1 ? std::stoul(argv[1]) : 1500;
+    std::mt19937_64 g(argc > 2 ? std::stoull(argv[2]) : 1);
+    auto r = [&](uint32_t n) { return (uint32_t)(g() % n); };
+
+    if (!chip8().use_jit(true)) {
+        std::cout << "no recompiler on this host" << std::endl;
+        return 77;
+    }
+
+    uint64_t frames = 0;
+    uint64_t instructions = 0;
+    size_t skipped = 0;
+
+    for (size_t t = 0; t < trials; t++) {
+        std::vector<uint8_t> rom = random_rom(g);
+        quirk_profile p = (quirk_profile)r(quirks_count);
+
+        auto interp = std::make_unique<chip8>();
+        auto jit = std::make_unique<chip8>();
+        auto check = std::make_unique<chip8>();
+
+        for (chip8 *c : {interp.get(), jit.get(), check.get()}) {
+            c->load(rom.data(), rom.size());
+            c->set_profile(p);
+            c->seed(t);
+        }
+        jit->use_jit(true);
+
+        size_t count = 1 + r(40);
+        size_t budget = 1 + r(r(2) ? 30 : 3000);
+
+        for (size_t f = 0; f < count; f++) {
+            for (int k = 0; k < 16; k++)
+                if (r(16) == 0) {
+                    uint8_t state = r(2) ? 0xFF : 0x0;
+                    interp->keypad[k] = jit->keypad[k] = state;
+                    check->keypad[k] = state;
+                }
+
+            if (!probe(*check, budget)) {
+                skipped++;
+                break;
+            }
+
+            instructions += interp->run(budget);
+            jit->run(budget);
+
+            snapshot a, b;
+            capture(*jit, a);
+            capture(*interp, b);
+
+            std::string what =
+                std::format("trial {} frame {} profile {}", t, f, (int)p);
+            if (!same_state(a, b, what.c_str()))
+                return 1;
+
+            interp->tick();
+            jit->tick();
+            check->tick();
+            frames++;
+        }
+    }
+
+    std::cout << std::format("{} trials, {} frames, {} instructions, "
+                             "{} skipped\n",
+                             trials, frames, instructions, skipped);
+    return 0;
+}
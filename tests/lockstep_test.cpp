@@ -0,0 +1,100 @@
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "fuzz.h"
+#include "lockstep.h"
+
+/**
+ * @brief runs random roms on every lane of a lockstep engine and on one
+ * chip8 per lane, and compares each lane with its machine after every frame
+ */
+int main(int argc, char *argv[])
+{
+    size_t trials = argc > 1 ? std::stoul(argv[1]) : 300;
+    std::mt19937_64 g(argc > 2 ? std::stoull(argv[2]) : 1);
+    auto r = [&](uint32_t n) { return (uint32_t)(g() % n); };
+
+    uint64_t frames = 0;
+    size_t skipped = 0;
+
+    for (size_t t = 0; t < trials; t++) {
+        std::vector<uint8_t> rom = random_rom(g);
+        quirk_profile p = (quirk_profile)r(quirks_count);
+        size_t count = 1 + r(max_lanes);
+
+        auto lanes = std::make_unique<lockstep>(count, p);
+        std::vector<std::unique_ptr<chip8>> machines;
+        std::vector<std::unique_ptr<chip8>> checks;
+
+        if (!lanes->load(rom.data(), rom.size())) {
+            std::cerr << "Error: trial " << t << ": rom did not load"
+                      << std::endl;
+            return 1;
+        }
+
+        for (size_t l = 0; l < count; l++) {
+            // some lanes share a seed and run exactly alike
+            uint64_t seed = r(4) ? l : 7;
+            lanes->seed(l, seed);
+
+            for (auto *set : {&machines, &checks}) {
+                set->push_back(std::make_unique<chip8>());
+                set->back()->load(rom.data(), rom.size());
+                set->back()->set_profile(p);
+                set->back()->seed(seed);
+            }
+        }
+
+        size_t length = 1 + r(30);
+        size_t budget = 1 + r(r(2) ? 30 : 3000);
+        bool defined = true;
+
+        for (size_t f = 0; f < length && defined; f++) {
+            for (size_t l = 0; l < count; l++)
+                for (int k = 0; k < 16; k++)
+                    if (r(16) == 0) {
+                        bool down = r(2);
+                        lanes->press(l, k, down);
+                        machines[l]->keypad[k] = down ? 0xFF : 0x0;
+                        checks[l]->keypad[k] = down ? 0xFF : 0x0;
+                    }
+
+            for (size_t l = 0; l < count; l++)
+                defined &= probe(*checks[l], budget);
+
+            if (!defined) {
+                skipped++;
+                break;
+            }
+
+            lanes->run(budget);
+            for (auto &c : machines)
+                c->run(budget);
+
+            for (size_t l = 0; l < count; l++) {
+                snapshot a, b;
+                lanes->capture(l, a);
+                capture(*machines[l], b);
+
+                std::string what =
+                    std::format("trial {} frame {} profile {} lane {}", t, f,
+                                (int)p, l);
+                if (!same_state(a, b, what.c_str()))
+                    return 1;
+            }
+
+            lanes->tick();
+            for (size_t l = 0; l < count; l++) {
+                machines[l]->tick();
+                checks[l]->tick();
+            }
+            frames++;
+        }
+    }
+
+    std::cout << std::format("{} trials, {} frames, {} skipped\n", trials,
+                             frames, skipped);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "rom.h"
+
+/**
+ * @brief a library written byte for byte, with two roms and their names
+ * after the index unless a case breaks it
+ */
+struct library {
+    const char *name;
+    library_header header;
+    std::vector<library_entry> entries;
+    size_t data_size;
+    bool valid;
+};
+
+static bool check(const library &l, const std::string &path);
+
+int main()
+{
+    // data starts after the header and two entries, 16 + 2 * 24 bytes
+    const library_header two = {library_magic, library_version, 2, 0};
+    const std::vector<library> cases = {
+        {"well formed", two, {{1, 64, 4, 68, 1}, {2, 69, 2, 71, 1}}, 8, true},
+        {"rom larger than the file",
+         two,
+         {{1, 1 << 20, 1000, 68, 1}, {2, 69, 2, 71, 1}},
+         8,
+         false},
+        {"rom past the end", two, {{1, 64, 4, 68, 1}, {2, 71, 2, 71, 1}}, 8,
+         false},
+        {"empty rom", two, {{1, 64, 0, 68, 1}, {2, 69, 2, 71, 1}}, 8, false},
+        {"name larger than the file",
+         two,
+         {{1, 64, 4, 1 << 20, 1000}, {2, 69, 2, 71, 1}},
+         8,
+         false},
+        {"name past the end", two, {{1, 64, 4, 68, 1}, {2, 69, 2, 72, 1}}, 8,
+         false},
+        {"unsorted index", two, {{2, 64, 4, 68, 1}, {1, 69, 2, 71, 1}}, 8,
+         false},
+        {"index past the end",
+         {library_magic, library_version, 3, 0},
+         {{1, 64, 4, 68, 1}, {2, 69, 2, 71, 1}},
+         0,
+         false},
+        {"wrong version",
+         {library_magic, library_version + 1, 2, 0},
+         {{1, 64, 4, 68, 1}, {2, 69, 2, 71, 1}},
+         8,
+         false},
+    };
+
+    std::string path =
+        (std::filesystem::temp_directory_path() / "chip8_rom_test.lib")
+            .string();
+    bool ok = true;
+
+    for (const library &l : cases)
+        ok &= check(l, path);
+
+    std::filesystem::remove(path);
+    return ok ? 0 : 1;
+}
+
+bool check(const library &l, const std::string &path)
+{
+    std::vector<uint8_t> bytes(sizeof(l.header));
+    memcpy(bytes.data(), &l.header, sizeof(l.header));
+
+    for (const library_entry &e : l.entries) {
+        const uint8_t *p = (const uint8_t *)&e;
+        bytes.insert(bytes.end(), p, p + sizeof(e));
+    }
+
+    for (size_t j = 0; j < l.data_size; j++)
+        bytes.push_back(0x10 + j);
+
+    std::ofstream(path, std::ios::binary)
+        .write((const char *)bytes.data(), bytes.size());
+
+    rom_library library;
+    bool opened = library.open(path.c_str());
+
+    if (opened != l.valid) {
+        std::cerr << "Error: " << l.name << " library "
+                  << (opened ? "opened" : "did not open") << std::endl;
+        return false;
+    }
+
+    if (opened && (library.count() != l.entries.size() ||
+                   library.rom(*library.find(2))[0] != 0x15 ||
+                   library.name(library.entry(0)) != "\x14")) {
+        std::cerr << "Error: " << l.name << " library reads back wrong"
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,69 @@
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "state.h"
+
+/**
+ * @brief a snapshot field set to a value load_state() must accept or reject
+ */
+struct field {
+    const char *name;
+    size_t offset;
+    uint16_t value;
+    bool valid;
+};
+
+int main()
+{
+    const std::vector<field> fields = {
+        {"rom_end at font_addr", offsetof(snapshot, rom_end), font_addr,
+         true},
+        {"rom_end past font_addr", offsetof(snapshot, rom_end),
+         font_addr + 0x2, false},
+        {"rom_end past memory", offsetof(snapshot, rom_end), 0xFFFF, false},
+        {"sp at the bottom of .stack", offsetof(snapshot, sp), 0xEA0, true},
+        {"sp at the top of .stack", offsetof(snapshot, sp), 0xF00, true},
+        {"sp below .stack", offsetof(snapshot, sp), 0xE9E, false},
+        {"sp above .stack", offsetof(snapshot, sp), 0xF02, false},
+    };
+
+    std::string path =
+        (std::filesystem::temp_directory_path() / "chip8_state_test.st")
+            .string();
+
+    chip8 c;
+    const uint8_t rom[] = {0x60, 0x01, 0x12, 0x00};
+    c.load(rom, sizeof(rom));
+    c.run(10);
+
+    if (!save_state(c, path.c_str()) || !load_state(c, path.c_str())) {
+        std::cerr << "Error: cannot save and load a state" << std::endl;
+        return 1;
+    }
+
+    // u32 magic, u32 version, u32 size, then the snapshot
+    size_t header = 3 * sizeof(uint32_t);
+    bool ok = true;
+
+    for (const field &t : fields) {
+        save_state(c, path.c_str());
+
+        std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(header + t.offset);
+        f.write((const char *)&t.value, sizeof(t.value));
+        f.close();
+
+        chip8 loaded;
+        if (load_state(loaded, path.c_str()) != t.valid) {
+            std::cerr << "Error: state with " << t.name << " was "
+                      << (t.valid ? "rejected" : "loaded") << std::endl;
+            ok = false;
+        }
+    }
+
+    std::filesystem::remove(path);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <chrono>
+
+#include "trace.h"
+
+tracer::~tracer() { close(); }
+
+bool tracer::open(const char *path)
+{
+    f.open(path, std::ios::binary);
+
+    if (!f.is_open())
+        return false;
+
+    trace_header header = {trace_magic, trace_version, sizeof(trace_record),
+                           0};
+    f.write((const char *)&header, sizeof(header));
+
+    if (!f.good())
+        return false;
+
+    ring = new trace_record[trace_ring];
+    writer = std::thread(&tracer::drain, this);
+    return true;
+}
+
+void tracer::close()
+{
+    if (!writer.joinable())
+        return;
+
+    stop.store(true, std::memory_order_release);
+    writer.join();
+    f.close();
+
+    delete[] ring;
+    ring = nullptr;
+}
+
+void tracer::drain()
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+
+    for (;;) {
+        // read stop first so records published before it are still seen
+        bool last = stop.load(std::memory_order_acquire);
+        size_t h = head.load(std::memory_order_acquire);
+
+        if (h == t) {
+            if (last)
+                return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // write up to the end of the ring, the rest goes next time round
+        size_t at = t & (trace_ring - 1);
+        size_t n = std::min(h - t, (size_t)trace_ring - at);
+        f.write((const char *)&ring[at], n * sizeof(trace_record));
+
+        t += n;
+        tail.store(t, std::memory_order_release);
+    }
+}
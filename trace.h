@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#define trace_magic 0x52543843 // "C8TR"
+#define trace_version 1
+
+// capacity of the ring between the machine and the writer thread
+#define trace_ring (1 << 16)
+
+// trace_record::reg when the instruction left every register alone
+#define trace_none 0xFF
+// or'd into trace_record::reg when more than one register changed
+#define trace_more 0x10
+
+/**
+ * @brief trace file layout
+ * header  u32 magic, u32 version, u32 record size, u32 reserved
+ * records one trace_record per executed instruction, in order
+ */
+struct trace_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record;
+    uint32_t reserved;
+};
+
+/**
+ * @brief one executed instruction, pc is where it was fetched from, i is
+ * what it left behind and reg/value name the lowest register it changed
+ */
+struct trace_record {
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t i;
+    uint8_t reg;
+    uint8_t value;
+};
+
+/**
+ * @brief single producer single consumer ring of trace records, a writer
+ * thread drains it to disk so the machine never waits on the file unless
+ * the ring fills up
+ */
+class tracer
+{
+public:
+    tracer() = default;
+    ~tracer();
+
+    tracer(const tracer &) = delete;
+    tracer &operator=(const tracer &) = delete;
+
+    bool open(const char *path);
+
+    /**
+     * @brief flush everything recorded so far and stop the writer
+     */
+    void close();
+
+    /**
+     * @brief append one record, before holds v[] from ahead of the
+     * instruction and after the registers it left behind
+     */
+    void record(uint16_t pc, uint16_t opcode, uint16_t i,
+                const uint8_t *before, const uint8_t *after)
+    {
+        trace_record r = {pc, opcode, i, trace_none, 0};
+
+        if (memcmp(before, after, 16))
+            for (uint8_t x = 16; x-- > 0;) {
+                if (before[x] == after[x])
+                    continue;
+                r.reg = r.reg == trace_none ? x : x | trace_more;
+                r.value = after[x];
+            }
+
+        size_t h = head.load(std::memory_order_relaxed);
+        while (h - tail_seen == trace_ring) {
+            tail_seen = tail.load(std::memory_order_acquire);
+            if (h - tail_seen == trace_ring)
+                std::this_thread::yield();
+        }
+
+        ring[h & (trace_ring - 1)] = r;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+private:
+    void drain();
+
+    trace_record *ring = nullptr;
+    std::ofstream f;
+    std::thread writer;
+    std::atomic<bool> stop{false};
+
+    // head only moves on the machine thread and tail only on the writer
+    alignas(64) std::atomic<size_t> head{0};
+    size_t tail_seen = 0;
+    alignas(64) std::atomic<size_t> tail{0};
+};
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "disasm.h"
+#include "trace.h"
+
+/**
+ * @brief which records to print, every set condition has to hold
+ */
+struct trace_filter {
+    uint16_t pc_lo = 0x000;
+    uint16_t pc_hi = 0xFFF;
+    uint16_t op_mask = 0x0000; // nibbles --op pins down
+    uint16_t op_bits = 0x0000;
+    int reg = -1;              // lowest register that has to change
+    std::string find;          // text the disassembly has to contain
+};
+
+static bool parse_op(const std::string &pattern, trace_filter &f);
+static bool matches(const trace_filter &f, const trace_record &r,
+                    const std::string &text);
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: <trace> [--from <n>] [--count <n>] "
+                     "[--pc <lo>[-<hi>]] [--op <pattern>]\n"
+                     "       [--reg <x>] [--find <text>] [--summary]"
+                  << std::endl;
+        return 1;
+    }
+
+    uint64_t from = 0;
+    uint64_t count = UINT64_MAX;
+    bool summary = false;
+    trace_filter filter;
+
+    for (int arg = 2; arg < argc; arg++) {
+        std::string opt = argv[arg];
+        if (opt == "--from" && arg + 1 < argc)
+            from = std::stoull(argv[++arg]);
+        else if (opt == "--count" && arg + 1 < argc)
+            count = std::stoull(argv[++arg]);
+        else if (opt == "--pc" && arg + 1 < argc) {
+            std::string range = argv[++arg];
+            size_t dash = range.find('-');
+            filter.pc_lo = std::stoul(range.substr(0, dash), nullptr, 16);
+            filter.pc_hi = dash == std::string::npos
+                               ? filter.pc_lo
+                               : std::stoul(range.substr(dash + 1), nullptr,
+                                            16);
+        } else if (opt == "--op" && arg + 1 < argc) {
+            if (!parse_op(argv[++arg], filter)) {
+                std::cerr << "Error: --op takes four hex digits or '.'"
+                          << std::endl;
+                return 1;
+            }
+        } else if (opt == "--reg" && arg + 1 < argc)
+            filter.reg = std::stoul(argv[++arg], nullptr, 16) & 0xF;
+        else if (opt == "--find" && arg + 1 < argc)
+            filter.find = argv[++arg];
+        else if (opt == "--summary")
+            summary = true;
+        else {
+            std::cerr << "Error: unknown option " << opt << std::endl;
+            return 1;
+        }
+    }
+
+    std::ifstream f(argv[1], std::ios::binary);
+
+    if (!f.is_open()) {
+        std::cerr << "Error: invalid file" << std::endl;
+        return 1;
+    }
+
+    trace_header header;
+
+    if (!f.read((char *)&header, sizeof(header)) ||
+        header.magic != trace_magic || header.version != trace_version ||
+        header.record != sizeof(trace_record)) {
+        std::cerr << "Error: not a trace file" << std::endl;
+        return 1;
+    }
+
+    // most traces repeat a handful of opcodes, disassemble each one once
+    std::vector<std::string> text(0x10000);
+    std::vector<bool> known(0x10000);
+
+    std::map<std::string, uint64_t> mnemonics;
+    uint64_t shown = 0;
+
+    std::vector<trace_record> chunk(4096);
+
+    for (uint64_t index = 0; shown < count;) {
+        f.read((char *)chunk.data(), chunk.size() * sizeof(trace_record));
+        size_t n = f.gcount() / sizeof(trace_record);
+
+        if (n == 0)
+            break;
+
+        for (size_t j = 0; j < n && shown < count; j++, index++) {
+            const trace_record &r = chunk[j];
+
+            if (index < from)
+                continue;
+
+            if (!known[r.opcode]) {
+                text[r.opcode] = disassemble(r.opcode);
+                known[r.opcode] = true;
+            }
+
+            if (!matches(filter, r, text[r.opcode]))
+                continue;
+
+            shown++;
+
+            if (summary) {
+                const std::string &t = text[r.opcode];
+                mnemonics[t.substr(0, t.find(' '))]++;
+                continue;
+            }
+
+            std::string line = std::format(
+                "{:>10} {:0>3x}  {:0>2x} {:0>2x}  {:<24} i={:0>3x}", index,
+                r.pc, r.opcode >> 8, r.opcode & 0xFF, text[r.opcode], r.i);
+
+            if (r.reg != trace_none)
+                line += std::format("  v{:x}={:0>2x}{}", r.reg & 0xF, r.value,
+                                    r.reg & trace_more ? " +" : "");
+
+            std::cout << line << "\n";
+        }
+    }
+
+    if (summary) {
+        std::vector<std::pair<uint64_t, std::string>> sorted;
+        for (const auto &[name, hits] : mnemonics)
+            sorted.push_back({hits, name});
+        std::sort(sorted.rbegin(), sorted.rend());
+
+        for (const auto &[hits, name] : sorted)
+            std::cout << std::format("{:>12} {}", hits, name) << "\n";
+        std::cout << std::format("{:>12} total", shown) << std::endl;
+    }
+
+    return 0;
+}
+
+static bool parse_op(const std::string &pattern, trace_filter &f)
+{
+    if (pattern.size() != 4)
+        return false;
+
+    for (size_t j = 0; j < 4; j++) {
+        char c = pattern[j];
+        int shift = 12 - 4 * j;
+
+        if (c == '.')
+            continue;
+        if (!isxdigit(c))
+            return false;
+
+        f.op_mask |= 0xF << shift;
+        f.op_bits |= std::stoul(std::string(1, c), nullptr, 16) << shift;
+    }
+
+    return true;
+}
+
+static bool matches(const trace_filter &f, const trace_record &r,
+                    const std::string &text)
+{
+    if (r.pc < f.pc_lo || r.pc > f.pc_hi)
+        return false;
+
+    if ((r.opcode & f.op_mask) != f.op_bits)
+        return false;
+
+    if (f.reg >= 0 && (r.reg == trace_none || (r.reg & 0xF) != f.reg))
+        return false;
+
+    if (!f.find.empty() && text.find(f.find) == std::string::npos)
+        return false;
+
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief hands the newest T from one writer thread to one reader thread,
+ * three slots and an atomic index swap, neither side ever waits
+ *
+ * the writer fills write() and publish()es it, the reader acquire()s and
+ * then looks at read() until its next acquire(), frames published in
+ * between are dropped
+ */
+template <typename T> class triple_buffer
+{
+public:
+    T &write() { return slots[back]; }
+
+    void publish()
+    {
+        back = middle.exchange(back | fresh, std::memory_order_acq_rel) & 0x3;
+    }
+
+    /**
+     * @brief take the newest published slot, false if nothing was published
+     * since the last acquire
+     */
+    bool acquire()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & fresh))
+            return false;
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & 0x3;
+        return true;
+    }
+
+    const T &read() const { return slots[front]; }
+
+private:
+    // set in middle while it holds a slot the reader has not seen
+    static constexpr uint8_t fresh = 0x4;
+
+    T slots[3] = {};
+    uint8_t back = 0;
+    uint8_t front = 1;
+    std::atomic<uint8_t> middle{2};
+};
@@ -0,0 +1,87 @@
+#include "state.h"
+#include "vm.h"
+
+vm::vm() : c(new chip8) {}
+
+bool vm::load(const char *path, quirk_profile profile)
+{
+    std::unique_ptr<chip8> loaded(new chip8);
+
+    if (!loaded->load(path))
+        return false;
+
+    loaded->set_profile(profile);
+    start_from(std::move(loaded));
+    return true;
+}
+
+bool vm::load(const uint8_t *rom, size_t size, quirk_profile profile)
+{
+    std::unique_ptr<chip8> loaded(new chip8);
+
+    if (!loaded->load(rom, size))
+        return false;
+
+    loaded->set_profile(profile);
+    start_from(std::move(loaded));
+    return true;
+}
+
+void vm::start_from(std::unique_ptr<chip8> loaded)
+{
+    start = std::move(loaded);
+    reset();
+}
+
+void vm::reset(uint64_t seed)
+{
+    if (start)
+        clone_state(*c, *start);
+    c->seed(seed);
+}
+
+observation vm::step(uint16_t keys)
+{
+    for (size_t k = 0; k < 16; k++)
+        c->keypad[k] = keys >> k & 0x1 ? 0xFF : 0x0;
+
+    c->run(ipf);
+    c->tick();
+
+    return observe();
+}
+
+observation vm::observe()
+{
+    observation o = {c->framebuffer, c->dirty, c->hires, c->sound > 0,
+                     c->halted()};
+    c->dirty = 0;
+    return o;
+}
+
+void vm::clone_into(vm &into) const
+{
+    if (&into == this)
+        return;
+
+    clone_state(*into.c, *c);
+    into.start = start;
+    into.ipf = ipf;
+}
+
+vm vm::clone() const
+{
+    vm copy;
+    clone_into(copy);
+    return copy;
+}
+
+void step_batch(work_pool &pool, vm *machines, const uint16_t *keys,
+                observation *out, size_t count)
+{
+    pool.run(count, [&](size_t n) {
+        observation o = machines[n].step(keys[n]);
+        if (out)
+            out[n] = o;
+    });
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "chip8.h"
+#include "pool.h"
+
+/**
+ * @brief what a step leaves behind, pointing into the machine itself so
+ * nothing is copied, valid until the machine is stepped, reset or cloned
+ * into again
+ */
+struct observation {
+    const display_row (*framebuffer)[display_h];
+    uint64_t dirty; // rows drawn since the previous observation
+    bool hires;
+    bool sound;
+    bool halted;
+};
+
+/**
+ * @brief a rom stepped a frame at a time for agents, the keypad given as a
+ * bit mask per step
+ *
+ * Clones share the loaded rom and copy the rest. Cloning into a machine
+ * that already exists keeps its decoded instructions and translations
+ * wherever the two memories agree, which for siblings of one rom is all
+ * of the code.
+ */
+class vm
+{
+public:
+    vm();
+
+    /**
+     * @brief map a rom file or take one from memory and reset to it, false
+     * if it cannot be loaded
+     */
+    bool load(const char *path, quirk_profile profile = quirks_modern);
+    bool load(const uint8_t *rom, size_t size,
+              quirk_profile profile = quirks_modern);
+
+    /**
+     * @brief back to the state right after load(), with a new seed
+     */
+    void reset(uint64_t seed = 0);
+
+    /**
+     * @brief hold the keys set in keys (bit k is key k) for one frame of
+     * ipf instructions and a timer tick
+     */
+    observation step(uint16_t keys);
+
+    observation observe();
+
+    /**
+     * @brief make into a copy of this machine, reusing its allocations
+     */
+    void clone_into(vm &into) const;
+    vm clone() const;
+
+    chip8 &machine() { return *c; }
+    const chip8 &machine() const { return *c; }
+
+    size_t ipf = default_ipf;
+
+private:
+    void start_from(std::unique_ptr<chip8> loaded);
+
+    std::unique_ptr<chip8> c;
+
+    // the machine as loaded, shared by every clone
+    std::shared_ptr<const chip8> start;
+};
+
+/**
+ * @brief step count machines at once across the pool, machine n holding
+ * keys[n], out receives the observations unless it is null
+ */
+void step_batch(work_pool &pool, vm *machines, const uint16_t *keys,
+                observation *out, size_t count);